@@ -3,6 +3,10 @@
  breakout board, and uses the input to detect clapping sounds. An LED is
  togggled when a clapp is detected.
 
+ The envelope analyzer follows the room noise floor, so a clap is a rise
+ of the RMS envelope a fixed number of dB above it, whatever the gain of
+ the microphone.
+
  Circuit:
  * Arduino/Genuino Zero, MKRZero or MKR1000 board
  * ICS43432:
@@ -21,14 +25,11 @@
 // the LED pin to use as output
 const int ledPin = LED_BUILTIN;
 
-// the amplitude threshold for a clap to be detected
-const int amplitudeDeltaThreshold = 100000000;
-
-// create an amplitude analyzer to be used with the I2S input
-AmplitudeAnalyzer amplitudeAnalyzer;
+// how far above the noise floor a clap must rise, in dB
+const float clapThreshold = 20.0;
 
-// variable to keep track of last amplitude
-int lastAmplitude = 0;
+// create an envelope analyzer to be used with the I2S input
+EnvelopeAnalyzer envelopeAnalyzer;
 
 void setup() {
   // setup the serial
@@ -43,35 +44,36 @@ void setup() {
     while (1); // do nothing
   }
 
-  // configure the I2S input as the input for the amplitude analyzer
-  if (!amplitudeAnalyzer.input(AudioInI2S)) {
-    Serial.println("Failed to set amplitude analyzer input!");
+  // a fast attack catches the clap, a short release lets it end quickly
+  envelopeAnalyzer.setBallistics(1.0, 50.0);
+  envelopeAnalyzer.setThreshold(clapThreshold);
+
+  // configure the I2S input as the input for the envelope analyzer
+  if (!envelopeAnalyzer.input(AudioInI2S)) {
+    Serial.println("Failed to set envelope analyzer input!");
     while (1); // do nothing
   }
 }
 
 void loop() {
-  // check if a new analysis is available
-  if (amplitudeAnalyzer.available()) {
-    // read the new amplitude
-    int amplitude = amplitudeAnalyzer.read();
-
-    // find the difference between the new amplitude and the last
-    int delta = amplitude - lastAmplitude;
-  
-    // check if the difference is larger than the threshold
-    if (delta > amplitudeDeltaThreshold) {
-      // a clap was detected
-      Serial.println("clap detected");
-  
-      // toggle the LED
-      digitalWrite(ledPin, !digitalRead(ledPin));
-  
-      // delay a bit to debounce
-      delay(100);
+  // check if new envelope events are available
+  int count = envelopeAnalyzer.available();
+
+  if (count) {
+    EnvelopeEvent events[8];
+
+    count = envelopeAnalyzer.read(events, 8);
+
+    for (int i = 0; i < count; i++) {
+      // a rising event is the start of a clap
+      if (events[i].rising) {
+        Serial.print("clap detected, ");
+        Serial.print(events[i].level);
+        Serial.println(" dB");
+
+        // toggle the LED
+        digitalWrite(ledPin, !digitalRead(ledPin));
+      }
     }
-  
-    // update the last amplitude with the new amplitude
-    lastAmplitude = amplitude;
   }
 }
@@ -0,0 +1,209 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Times the magnitude, power and decibel kernels of FFTAnalyzer, built with its ESP32
+  code path, against the pow() / sqrt() loops they replaced. The kernels are checked
+  against the outputs of those loops, which are taken in double precision, and the
+  new power kernels against double precision products. Timings are printed only, the
+  test fails when a kernel is off by more than its bound.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include "FFTAnalyzer.h"
+
+#define BINS 512
+// transforms timed per kernel
+#define REPEATS 2000
+// worst relative error of the float magnitude and power
+#define FLOAT_MAX_ERROR 1e-6
+// worst error of the decibel kernels, dB
+#define DB_MAX_ERROR 1e-3
+// the integer square root truncates, worst error in LSB
+#define INT16_MAX_ERROR 1.0
+
+// the protected kernels made callable
+class HostFFT : public FFTAnalyzer
+{
+public:
+  HostFFT() : FFTAnalyzer(2 * BINS) {}
+
+  using FFTAnalyzer::float_cmplx_mag;
+  using FFTAnalyzer::float_cmplx_mag_squared;
+  using FFTAnalyzer::float_cmplx_mag_db;
+  using FFTAnalyzer::int16_cmplx_mag;
+  using FFTAnalyzer::int16_cmplx_mag_squared;
+  using FFTAnalyzer::int16_cmplx_mag_db;
+};
+
+// the kernels before setOutput(), with a decibel loop written the same way
+static void oldFloatMag(float* pSrc, float* pDst, uint32_t numSamples)
+{
+  for (uint32_t n = 0; n < numSamples; n++) {
+    pDst[n] = (float)sqrt(pow(pSrc[(2*n)+0], 2.0) + pow(pSrc[(2*n)+1], 2.0));
+  }
+}
+
+static void oldFloatDb(float* pSrc, float* pDst, uint32_t numSamples)
+{
+  for (uint32_t n = 0; n < numSamples; n++) {
+    pDst[n] = (float)(10.0 * log10(pow(pSrc[(2*n)+0], 2.0) + pow(pSrc[(2*n)+1], 2.0)));
+  }
+}
+
+static void oldInt16Mag(int16_t* pSrc, float* pDst, uint32_t numSamples)
+{
+  for (uint32_t n = 0; n < numSamples; n++) {
+    pDst[n] = (float)sqrt(pow(pSrc[(2*n)+0], 2.0) + pow(pSrc[(2*n)+1], 2.0));
+  }
+}
+
+static uint32_t seed = 1;
+
+// deterministic samples in [-amplitude, amplitude]
+static double noise(double amplitude)
+{
+  seed = seed * 1664525u + 1013904223u;
+
+  return amplitude * ((double)(seed >> 8) / 8388608.0 - 1.0);
+}
+
+template<typename T, typename Kernel> static double nanosecondsPerBin(Kernel kernel, T* input, float* output)
+{
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for (int r = 0; r < REPEATS; r++) {
+    kernel(input, output, BINS);
+  }
+
+  return 1e9 * std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count() / REPEATS / BINS;
+}
+
+static int report(const char* name, double newTime, double oldTime, double error, double maxError)
+{
+  int ok = error <= maxError;
+
+  if (oldTime > 0.0) {
+    printf("%-16s %6.2f ns/bin, pow()/sqrt() %6.2f ns/bin, speedup %5.2fx, error %.2e (max %.0e) %s\n",
+           name, newTime, oldTime, oldTime / newTime, error, maxError, ok ? "ok" : "FAILED");
+  } else {
+    printf("%-16s %6.2f ns/bin, error %.2e (max %.0e) %s\n",
+           name, newTime, error, maxError, ok ? "ok" : "FAILED");
+  }
+
+  return ok ? 0 : 1;
+}
+
+int main()
+{
+  HostFFT fft;
+  std::vector<float> floatBins(2 * BINS);
+  std::vector<int16_t> int16Bins(2 * BINS);
+  std::vector<float> output(BINS);
+  std::vector<float> oldOutput(BINS);
+  int failures = 0;
+
+  // bins over a wide dynamic range, and the extremes of sc16
+  for (int i = 0; i < 2 * BINS; i++) {
+    floatBins[i] = (float)(noise(1.0) * pow(10.0, noise(4.0)));
+    int16Bins[i] = (int16_t)lround(noise(32767.0));
+  }
+  int16Bins[0] = -32768;
+  int16Bins[1] = -32768;
+  int16Bins[2] = 32767;
+  int16Bins[3] = 0;
+
+  auto floatMag = [&](float* in, float* out, uint32_t n) { fft.float_cmplx_mag(in, out, n); };
+  auto floatPower = [&](float* in, float* out, uint32_t n) { fft.float_cmplx_mag_squared(in, out, n); };
+  auto floatDb = [&](float* in, float* out, uint32_t n) { fft.float_cmplx_mag_db(in, out, n); };
+  auto int16Mag = [&](int16_t* in, float* out, uint32_t n) { fft.int16_cmplx_mag(in, out, n); };
+  auto int16Power = [&](int16_t* in, float* out, uint32_t n) { fft.int16_cmplx_mag_squared(in, out, n); };
+  auto int16Db = [&](int16_t* in, float* out, uint32_t n) { fft.int16_cmplx_mag_db(in, out, n); };
+
+  double newTime, oldTime, worst;
+
+  newTime = nanosecondsPerBin(floatMag, floatBins.data(), output.data());
+  oldTime = nanosecondsPerBin(oldFloatMag, floatBins.data(), oldOutput.data());
+  worst = 0.0;
+  for (int n = 0; n < BINS; n++) {
+    worst = fmax(worst, fabs(output[n] - oldOutput[n]) / oldOutput[n]);
+  }
+  failures += report("float magnitude", newTime, oldTime, worst, FLOAT_MAX_ERROR);
+
+  newTime = nanosecondsPerBin(floatPower, floatBins.data(), output.data());
+  worst = 0.0;
+  for (int n = 0; n < BINS; n++) {
+    double re = floatBins[2*n];
+    double im = floatBins[2*n+1];
+    double reference = re * re + im * im;
+
+    worst = fmax(worst, fabs(output[n] - reference) / reference);
+  }
+  failures += report("float power", newTime, 0.0, worst, FLOAT_MAX_ERROR);
+
+  newTime = nanosecondsPerBin(floatDb, floatBins.data(), output.data());
+  oldTime = nanosecondsPerBin(oldFloatDb, floatBins.data(), oldOutput.data());
+  worst = 0.0;
+  for (int n = 0; n < BINS; n++) {
+    worst = fmax(worst, fabs(output[n] - oldOutput[n]));
+  }
+  failures += report("float dB", newTime, oldTime, worst, DB_MAX_ERROR);
+
+  newTime = nanosecondsPerBin(int16Mag, int16Bins.data(), output.data());
+  oldTime = nanosecondsPerBin(oldInt16Mag, int16Bins.data(), oldOutput.data());
+  worst = 0.0;
+  for (int n = 0; n < BINS; n++) {
+    worst = fmax(worst, fabs(output[n] - oldOutput[n]));
+  }
+  failures += report("int16 magnitude", newTime, oldTime, worst, INT16_MAX_ERROR);
+
+  newTime = nanosecondsPerBin(int16Power, int16Bins.data(), output.data());
+  worst = 0.0;
+  for (int n = 0; n < BINS; n++) {
+    double re = int16Bins[2*n];
+    double im = int16Bins[2*n+1];
+    double reference = re * re + im * im;
+
+    if (reference > 0.0) {
+      worst = fmax(worst, fabs(output[n] - reference) / reference);
+    }
+  }
+  failures += report("int16 power", newTime, 0.0, worst, FLOAT_MAX_ERROR);
+
+  newTime = nanosecondsPerBin(int16Db, int16Bins.data(), output.data());
+  worst = 0.0;
+  for (int n = 0; n < BINS; n++) {
+    double re = int16Bins[2*n];
+    double im = int16Bins[2*n+1];
+
+    // the fast log clamps a silent bin instead of returning -inf
+    if (re != 0.0 || im != 0.0) {
+      worst = fmax(worst, fabs(output[n] - 10.0 * log10(re * re + im * im)));
+    }
+  }
+  failures += report("int16 dB", newTime, 0.0, worst, DB_MAX_ERROR);
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
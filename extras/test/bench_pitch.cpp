@@ -0,0 +1,178 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Times PitchAnalyzer, built with its ESP32 code path and the esp-dsp ANSI kernels,
+  against the same YIN estimate with the difference function computed directly,
+  length^2 / 2 products per window, and checks that both find the same frequency.
+  Timings are printed only, the test fails when the estimates disagree.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include "PitchAnalyzer.h"
+
+#define SAMPLE_RATE 44100
+// estimates timed per length
+#define WINDOWS 20
+// largest difference between the two estimates, Hz
+#define MAX_DIFFERENCE 0.05
+
+// 16-bit mono input fed from memory
+class HostInput : public AudioIn
+{
+public:
+  virtual long sampleRate() { return SAMPLE_RATE; }
+  virtual int bitsPerSample() { return 16; }
+  virtual int channels() { return 1; }
+  virtual int read(void*, size_t) { return 0; }
+
+  void feed(const int16_t* samples, int count) {
+    samplesRead((void*)samples, count * sizeof(int16_t));
+  }
+
+protected:
+  virtual int begin() { return 1; }
+  virtual int reset() { return 1; }
+  virtual void end() {}
+};
+
+// PitchAnalyzer::estimate() with the difference function summed directly
+static float naiveYin(const int16_t* samples, int length, float threshold)
+{
+  int maxTau = length / 2;
+  std::vector<float> d(maxTau + 1);
+  float sum = 0.0f;
+
+  d[0] = 1.0f;
+
+  for (int tau = 1; tau <= maxTau; tau++) {
+    float difference = 0.0f;
+
+    for (int j = 0; j < length - tau; j++) {
+      float delta = (float)samples[j] - (float)samples[j + tau];
+
+      difference += delta * delta;
+    }
+
+    sum += difference;
+    d[tau] = (sum > 0.0f) ? difference * tau / sum : 1.0f;
+  }
+
+  for (int tau = 2; tau <= maxTau; tau++) {
+    if (d[tau] < threshold) {
+      while (tau < maxTau && d[tau + 1] < d[tau]) {
+        tau++;
+      }
+
+      float period = tau;
+
+      if (tau < maxTau) {
+        float a = d[tau - 1];
+        float b = d[tau];
+        float c = d[tau + 1];
+        float curvature = a - 2.0f * b + c;
+
+        if (curvature > 0.0f) {
+          period += 0.5f * (a - c) / curvature;
+        }
+      }
+
+      return SAMPLE_RATE / period;
+    }
+  }
+
+  return 0.0f;
+}
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+  int failures = 0;
+
+  for (int length = 512; length <= 4096; length *= 2) {
+    // a voice like tone with two harmonics, low enough for the shortest window
+    float frequency = 4.0f * SAMPLE_RATE / length + 37.0f;
+    std::vector<int16_t> samples(WINDOWS * length);
+
+    for (size_t n = 0; n < samples.size(); n++) {
+      float phase = 2.0f * (float)M_PI * frequency * n / SAMPLE_RATE;
+
+      samples[n] = (int16_t)(8000.0f * sinf(phase) + 4000.0f * sinf(2.0f * phase) + 2000.0f * sinf(3.0f * phase));
+    }
+
+    HostInput input;
+    PitchAnalyzer pitch(length);
+
+    if (!pitch.input(input)) {
+      printf("length %4d: input() failed\n", length);
+      failures++;
+      continue;
+    }
+
+    float fastFrequency[WINDOWS];
+    float naiveFrequency[WINDOWS];
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (int w = 0; w < WINDOWS; w++) {
+      float confidence;
+
+      input.feed(&samples[w * length], length);
+      if (!pitch.read(&fastFrequency[w], &confidence)) {
+        fastFrequency[w] = -1.0f;
+      }
+    }
+
+    double fastTime = seconds(start);
+
+    start = std::chrono::steady_clock::now();
+    for (int w = 0; w < WINDOWS; w++) {
+      naiveFrequency[w] = naiveYin(&samples[w * length], length, 0.15f);
+    }
+
+    double naiveTime = seconds(start);
+    double worst = 0.0;
+
+    for (int w = 0; w < WINDOWS; w++) {
+      worst = fmax(worst, fabs(fastFrequency[w] - naiveFrequency[w]));
+    }
+
+    int ok = worst <= MAX_DIFFERENCE && fabs(fastFrequency[0] - frequency) < 0.01f * frequency;
+
+    printf("length %4d, %7.2f Hz: FFT %8.1f us, direct %9.1f us per window, %5.1fx faster, "
+           "estimates %.2f Hz, differ by %.4f Hz %s\n",
+           length, frequency, 1e6 * fastTime / WINDOWS, 1e6 * naiveTime / WINDOWS, naiveTime / fastTime,
+           fastFrequency[0], worst, ok ? "ok" : "FAILED");
+
+    if (!ok) {
+      failures++;
+    }
+  }
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,37 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef _HOST_ARDUINO_H_INCLUDED
+#define _HOST_ARDUINO_H_INCLUDED
+
+// the parts of the Arduino core the analyzers use, for the host builds in extras/test
+
+#include <math.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#ifndef PI
+  #define PI 3.1415926535897932384626433832795
+#endif
+
+// the host has no I2S interrupt
+inline void noInterrupts() {}
+inline void interrupts() {}
+
+#endif
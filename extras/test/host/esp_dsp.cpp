@@ -0,0 +1,165 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+// same algorithms as the esp-dsp ANSI C kernels of the same names
+
+#include "esp_dsp.h"
+
+#include <math.h>
+
+esp_err_t dsps_gen_w_r2_fc32(float* w, int N)
+{
+  float e = (float)(2.0 * M_PI / N);
+
+  for (int i = 0; i < (N >> 1); i++) {
+    w[2 * i] = cosf(i * e);
+    w[2 * i + 1] = sinf(i * e);
+  }
+
+  return 0;
+}
+
+esp_err_t dsps_bit_rev_fc32_ansi(float* data, int N)
+{
+  int j = 0;
+
+  for (int i = 1; i < N - 1; i++) {
+    int k = N >> 1;
+
+    while (k <= j) {
+      j -= k;
+      k >>= 1;
+    }
+    j += k;
+
+    if (i < j) {
+      float re = data[2 * j];
+      float im = data[2 * j + 1];
+
+      data[2 * j] = data[2 * i];
+      data[2 * j + 1] = data[2 * i + 1];
+      data[2 * i] = re;
+      data[2 * i + 1] = im;
+    }
+  }
+
+  return 0;
+}
+
+// radix-2 decimation in time, bit reversed twiddles, output in bit reversed order
+esp_err_t dsps_fft2r_fc32_ansi_(float* data, int N, float* w)
+{
+  int ie = 1;
+
+  for (int N2 = N / 2; N2 > 0; N2 >>= 1) {
+    int ia = 0;
+
+    for (int j = 0; j < ie; j++) {
+      float c = w[2 * j];
+      float s = w[2 * j + 1];
+
+      for (int i = 0; i < N2; i++) {
+        int m = ia + N2;
+        float re = c * data[2 * m] + s * data[2 * m + 1];
+        float im = c * data[2 * m + 1] - s * data[2 * m];
+
+        data[2 * m] = data[2 * ia] - re;
+        data[2 * m + 1] = data[2 * ia + 1] - im;
+        data[2 * ia] = data[2 * ia] + re;
+        data[2 * ia + 1] = data[2 * ia + 1] + im;
+        ia++;
+      }
+      ia += N2;
+    }
+    ie <<= 1;
+  }
+
+  return 0;
+}
+
+esp_err_t dsps_gen_w_r2_sc16(int16_t* w, int N)
+{
+  float e = (float)(2.0 * M_PI / N);
+
+  for (int i = 0; i < (N >> 1); i++) {
+    w[2 * i] = (int16_t)(INT16_MAX * cosf(i * e));
+    w[2 * i + 1] = (int16_t)(INT16_MAX * sinf(i * e));
+  }
+
+  return 0;
+}
+
+esp_err_t dsps_bit_rev_sc16_ansi(int16_t* data, int N)
+{
+  int j = 0;
+
+  for (int i = 1; i < N - 1; i++) {
+    int k = N >> 1;
+
+    while (k <= j) {
+      j -= k;
+      k >>= 1;
+    }
+    j += k;
+
+    if (i < j) {
+      int16_t re = data[2 * j];
+      int16_t im = data[2 * j + 1];
+
+      data[2 * j] = data[2 * i];
+      data[2 * j + 1] = data[2 * i + 1];
+      data[2 * i] = re;
+      data[2 * i + 1] = im;
+    }
+  }
+
+  return 0;
+}
+
+// the fc32 butterflies in Q15, every stage halves its output so it cannot overflow
+esp_err_t dsps_fft2r_sc16_ansi_(int16_t* data, int N, int16_t* w)
+{
+  int ie = 1;
+
+  for (int N2 = N / 2; N2 > 0; N2 >>= 1) {
+    int ia = 0;
+
+    for (int j = 0; j < ie; j++) {
+      int32_t c = w[2 * j];
+      int32_t s = w[2 * j + 1];
+
+      for (int i = 0; i < N2; i++) {
+        int m = ia + N2;
+        int32_t re = c * data[2 * m] + s * data[2 * m + 1];
+        int32_t im = c * data[2 * m + 1] - s * data[2 * m];
+        int32_t aRe = (int32_t)data[2 * ia] << 15;
+        int32_t aIm = (int32_t)data[2 * ia + 1] << 15;
+
+        data[2 * m] = (int16_t)((aRe - re) >> 16);
+        data[2 * m + 1] = (int16_t)((aIm - im) >> 16);
+        data[2 * ia] = (int16_t)((aRe + re) >> 16);
+        data[2 * ia + 1] = (int16_t)((aIm + im) >> 16);
+        ia++;
+      }
+      ia += N2;
+    }
+    ie <<= 1;
+  }
+
+  return 0;
+}
@@ -0,0 +1,37 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef _HOST_ESP_DSP_H_INCLUDED
+#define _HOST_ESP_DSP_H_INCLUDED
+
+// the esp-dsp ANSI kernels the analyzers call, for the host builds in extras/test
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+typedef int esp_err_t;
+
+esp_err_t dsps_gen_w_r2_fc32(float* w, int N);
+esp_err_t dsps_bit_rev_fc32_ansi(float* data, int N);
+esp_err_t dsps_fft2r_fc32_ansi_(float* data, int N, float* w);
+esp_err_t dsps_gen_w_r2_sc16(int16_t* w, int N);
+esp_err_t dsps_bit_rev_sc16_ansi(int16_t* data, int N);
+esp_err_t dsps_fft2r_sc16_ansi_(int16_t* data, int N, int16_t* w);
+
+#endif
@@ -0,0 +1,58 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef _HOST_INPUT_H_INCLUDED
+#define _HOST_INPUT_H_INCLUDED
+
+// an AudioIn fed from memory, for the host builds in extras/test
+
+#include "AudioIn.h"
+
+class HostInput : public AudioIn
+{
+public:
+  HostInput(long sampleRate, int bitsPerSample, int channels) :
+    _sampleRate(sampleRate),
+    _bitsPerSample(bitsPerSample),
+    _channelCount(channels)
+  {
+  }
+
+  virtual long sampleRate() { return _sampleRate; }
+  virtual int bitsPerSample() { return _bitsPerSample; }
+  virtual int channels() { return _channelCount; }
+  // the analyzers that pull on ESP32 get nothing, the samples are pushed by feed()
+  virtual int read(void*, size_t) { return 0; }
+
+  // hands size bytes of interleaved samples to the analyzers, as the I2S driver does
+  void feed(const void* samples, size_t size) {
+    samplesRead((void*)samples, size);
+  }
+
+protected:
+  virtual int begin() { return 1; }
+  virtual int reset() { return 1; }
+  virtual void end() {}
+
+private:
+  long _sampleRate;
+  int _bitsPerSample;
+  int _channelCount;
+};
+
+#endif
@@ -0,0 +1,188 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Feeds EnvelopeAnalyzer synthetic programmes at 16 kHz with the default settings and
+  checks its events and noise floor:
+
+  - two 50 ms bursts 30 dB over white noise each give one rising event at their start
+    and one falling event within the release that follows
+  - a 14 dB noise step moves the floor by 14 dB within the 2 s floor window
+  - 1 LSB of hiss after digital silence gives no event
+
+  Built once with the ESP32 float envelopes and once with the SAMD fixed point ones.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "EnvelopeAnalyzer.h"
+#include "host_input.h"
+
+#define SAMPLE_RATE 16000
+// frames per block handed to the analyzer
+#define BLOCK_FRAMES 160
+#define NOISE_AMPLITUDE 300.0
+#define BURST_AMPLITUDE 8000.0
+// a rising event has to come within this many ms of the start of its burst
+#define RISE_MAX_DELAY 20
+// and the falling one within this many ms of its end
+#define FALL_MAX_DELAY 500
+#define FLOOR_STEP 14.0
+#define FLOOR_MAX_ERROR 1.5
+
+static uint32_t seed = 1;
+
+// deterministic samples in [-amplitude, amplitude]
+static double noise(double amplitude)
+{
+  seed = seed * 1664525u + 1013904223u;
+
+  return amplitude * ((double)(seed >> 8) / 8388608.0 - 1.0);
+}
+
+enum Signal {
+  SIGNAL_SILENCE,
+  SIGNAL_HISS, // -1, 0 or 1 LSB
+  SIGNAL_NOISE,
+  SIGNAL_BURST // a 1 kHz sine over the noise
+};
+
+// feeds milliseconds of signal, noise scaled by gain
+static void feed(HostInput& input, Signal signal, int milliseconds, double gain = 1.0)
+{
+  static long frame = 0;
+  int16_t block[BLOCK_FRAMES];
+  long frames = (long)milliseconds * SAMPLE_RATE / 1000;
+
+  while (frames > 0) {
+    int n = (frames < BLOCK_FRAMES) ? (int)frames : BLOCK_FRAMES;
+
+    for (int i = 0; i < n; i++, frame++) {
+      double x = 0.0;
+
+      if (signal == SIGNAL_HISS) {
+        x = floor(noise(1.5) + 0.5);
+      } else if (signal != SIGNAL_SILENCE) {
+        x = noise(gain * NOISE_AMPLITUDE);
+      }
+
+      if (signal == SIGNAL_BURST) {
+        x += BURST_AMPLITUDE * sin(2.0 * M_PI * 1000.0 * frame / SAMPLE_RATE);
+      }
+
+      block[i] = (int16_t)lround(x);
+    }
+
+    input.feed(block, n * sizeof(int16_t));
+    frames -= n;
+  }
+}
+
+static int report(const char* name, int ok)
+{
+  printf("%-60s %s\n", name, ok ? "ok" : "FAILED");
+
+  return ok ? 0 : 1;
+}
+
+static int checkBursts()
+{
+  HostInput input(SAMPLE_RATE, 16, 1);
+  EnvelopeAnalyzer envelope;
+  int failures = 0;
+
+  if (!envelope.input(input)) {
+    return report("bursts: input() failed", 0);
+  }
+
+  static const uint32_t starts[] = { 3000, 4050 };
+
+  feed(input, SIGNAL_NOISE, 3000);
+  feed(input, SIGNAL_BURST, 50);
+  feed(input, SIGNAL_NOISE, 1000);
+  feed(input, SIGNAL_BURST, 50);
+  feed(input, SIGNAL_NOISE, 1950);
+
+  EnvelopeEvent events[8];
+  int count = envelope.read(events, 8);
+  char name[96];
+
+  snprintf(name, sizeof(name), "bursts: %d events, expected 4", count);
+  failures += report(name, count == 4);
+
+  for (int i = 0; i < count && i < 4; i++) {
+    uint32_t start = starts[i / 2];
+    bool rising = (i % 2) == 0;
+    int ok = events[i].rising == rising;
+
+    if (rising) {
+      ok = ok && events[i].time >= start && events[i].time <= start + RISE_MAX_DELAY;
+    } else {
+      ok = ok && events[i].time >= start + 50 && events[i].time <= start + 50 + FALL_MAX_DELAY;
+    }
+
+    snprintf(name, sizeof(name), "bursts: %s at %u ms, %.1f dB over the floor",
+             events[i].rising ? "rising" : "falling", events[i].time, events[i].level);
+    failures += report(name, ok);
+  }
+
+  float before = envelope.noiseFloor();
+
+  feed(input, SIGNAL_NOISE, 2500, pow(10.0, FLOOR_STEP / 20.0));
+
+  float after = envelope.noiseFloor();
+  double step = 20.0 * log10(after / before);
+
+  snprintf(name, sizeof(name), "noise step: floor %.1f to %.1f, %.2f dB, expected %.0f +- %.1f",
+           before, after, step, FLOOR_STEP, FLOOR_MAX_ERROR);
+  failures += report(name, before > 0.0f && fabs(step - FLOOR_STEP) <= FLOOR_MAX_ERROR);
+
+  return failures;
+}
+
+static int checkHiss()
+{
+  HostInput input(SAMPLE_RATE, 16, 1);
+  EnvelopeAnalyzer envelope;
+
+  if (!envelope.input(input)) {
+    return report("hiss: input() failed", 0);
+  }
+
+  feed(input, SIGNAL_SILENCE, 3000);
+  feed(input, SIGNAL_HISS, 1000);
+
+  char name[96];
+  int count = envelope.available();
+
+  snprintf(name, sizeof(name), "hiss after digital silence: %d events, expected 0", count);
+
+  return report(name, count == 0);
+}
+
+int main()
+{
+  int failures = checkBursts() + checkHiss();
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,190 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Compares the real input split step of the ESP32 FFTAnalyzer path against a naive
+  double precision DFT of the real samples and prints the worst error per length.
+
+  The int16 split gets the length / 2 point DFT scaled by 2 / length and rounded,
+  the output of the sc16 kernels, and must return the length point DFT scaled by
+  1 / length. The float split gets the unscaled DFT and must return the unscaled bins.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "FFTSplit.h"
+
+// worst bin error in LSB of the int16 output, the >> 1 steps truncate
+#define INT16_MAX_ERROR 3.0
+// worst bin error relative to the largest bin
+#define FLOAT_MAX_ERROR 1e-6
+
+static uint32_t seed = 1;
+
+// deterministic samples in [-amplitude, amplitude]
+static double noise(double amplitude)
+{
+  seed = seed * 1664525u + 1013904223u;
+
+  return amplitude * ((double)(seed >> 8) / 8388608.0 - 1.0);
+}
+
+// X[k] = sum x[n] * e^(-j*2*pi*k*n/length) of complex input
+static void dft(const double* input, double* output, int length)
+{
+  for (int k = 0; k < length; k++) {
+    double re = 0.0;
+    double im = 0.0;
+
+    for (int n = 0; n < length; n++) {
+      double phase = 2.0 * M_PI * (double)((long)k * n % length) / length;
+
+      re += input[2*n] * cos(phase) + input[2*n+1] * sin(phase);
+      im += input[2*n+1] * cos(phase) - input[2*n] * sin(phase);
+    }
+
+    output[2*k] = re;
+    output[2*k+1] = im;
+  }
+}
+
+// expected bins 0 .. length / 2 of the real samples, and the packed half size DFT
+static void reference(const std::vector<double>& samples, std::vector<double>& bins, std::vector<double>& packed)
+{
+  int length = samples.size();
+  int half = length / 2;
+  std::vector<double> complexSamples(2 * length, 0.0);
+  std::vector<double> spectrum(2 * length);
+
+  for (int n = 0; n < length; n++) {
+    complexSamples[2*n] = samples[n];
+  }
+  dft(complexSamples.data(), spectrum.data(), length);
+  bins.assign(spectrum.begin(), spectrum.begin() + 2 * (half + 1));
+
+  packed.resize(2 * half);
+  dft(samples.data(), packed.data(), half);
+}
+
+// Re and Im of bin k of a split output, DC and Nyquist are packed in bin 0
+template<typename T> static void splitBin(const T* buffer, int k, int half, double* re, double* im)
+{
+  if (k == 0) {
+    *re = buffer[0];
+    *im = 0.0;
+  } else if (k == half) {
+    *re = buffer[1];
+    *im = 0.0;
+  } else {
+    *re = buffer[2*k];
+    *im = buffer[2*k+1];
+  }
+}
+
+static double checkInt16(int length)
+{
+  int half = length / 2;
+  std::vector<double> samples(length);
+  std::vector<double> bins;
+  std::vector<double> packed;
+  std::vector<int16_t> buffer(2 * half);
+  std::vector<int16_t> twiddles(2 * (length / 4 + 1));
+
+  for (int n = 0; n < length; n++) {
+    samples[n] = floor(noise(16000.0));
+  }
+  reference(samples, bins, packed);
+
+  for (int i = 0; i < 2 * half; i++) {
+    buffer[i] = (int16_t)lround(packed[i] / half);
+  }
+
+  fft_split_twiddles_int16(twiddles.data(), length);
+  fft_split_real_int16(buffer.data(), twiddles.data(), length);
+
+  double worst = 0.0;
+
+  for (int k = 0; k <= half; k++) {
+    double re, im;
+
+    splitBin(buffer.data(), k, half, &re, &im);
+    worst = fmax(worst, hypot(re - bins[2*k] / length, im - bins[2*k+1] / length));
+  }
+
+  return worst;
+}
+
+static double checkFloat(int length)
+{
+  int half = length / 2;
+  std::vector<double> samples(length);
+  std::vector<double> bins;
+  std::vector<double> packed;
+  std::vector<float> buffer(2 * half);
+  std::vector<float> twiddles(2 * (length / 4 + 1));
+
+  for (int n = 0; n < length; n++) {
+    samples[n] = noise(1.0);
+  }
+  reference(samples, bins, packed);
+
+  for (int i = 0; i < 2 * half; i++) {
+    buffer[i] = (float)packed[i];
+  }
+
+  fft_split_twiddles_float(twiddles.data(), length);
+  fft_split_real_float(buffer.data(), twiddles.data(), length);
+
+  double worst = 0.0;
+  double largest = 0.0;
+
+  for (int k = 0; k <= half; k++) {
+    double re, im;
+
+    splitBin(buffer.data(), k, half, &re, &im);
+    worst = fmax(worst, hypot(re - bins[2*k], im - bins[2*k+1]));
+    largest = fmax(largest, hypot(bins[2*k], bins[2*k+1]));
+  }
+
+  return worst / largest;
+}
+
+int main()
+{
+  int failures = 0;
+
+  for (int length = 8; length <= 2048; length *= 2) {
+    double int16Error = checkInt16(length);
+    double floatError = checkFloat(length);
+    int ok = int16Error <= INT16_MAX_ERROR && floatError <= FLOAT_MAX_ERROR;
+
+    printf("length %4d: int16 %.3f LSB (max %.1f), float %.2e relative (max %.0e) %s\n",
+           length, int16Error, INT16_MAX_ERROR, floatError, FLOAT_MAX_ERROR, ok ? "ok" : "FAILED");
+
+    if (!ok) {
+      failures++;
+    }
+  }
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,137 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Feeds LoudnessAnalyzer the stereo sine programmes of the EBU loudness test sets and
+  checks the readings against their expected values:
+
+  - 997 Hz at -23 dBFS for 20 s at 16, 44.1 and 48 kHz reads -23 LUFS, momentary,
+    short-term and integrated
+  - EBU Tech 3341 case 3, 1 kHz at -36, -23 and -36 dBFS for 10, 60 and 10 s,
+    reads an integrated -23 LUFS
+  - EBU Tech 3342 case 1, 1 kHz at -20 then -30 dBFS for 20 s each, reads an LRA of 10 LU
+
+  The bounds are the tolerances of the test sets, +-0.1 LU and +-1 LU for the LRA.
+  Built once with the ESP32 float filters and once with the SAMD fixed point ones.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "LoudnessAnalyzer.h"
+#include "host_input.h"
+
+#define LOUDNESS_MAX_ERROR 0.1
+#define RANGE_MAX_ERROR 1.0
+// frames per block handed to the analyzer
+#define BLOCK_FRAMES 1024
+
+struct Segment {
+  float decibels; // sine peak in dBFS
+  float seconds;
+};
+
+// feeds the segments, one stereo sine of frequency, and reads the levels at the end
+static int measure(long sampleRate, float frequency, const Segment* segments, int count, LoudnessLevels* levels)
+{
+  HostInput input(sampleRate, 16, 2);
+  LoudnessAnalyzer loudness;
+
+  if (!loudness.input(input)) {
+    return 0;
+  }
+
+  std::vector<int16_t> block(2 * BLOCK_FRAMES);
+  double phase = 0.0;
+  double step = 2.0 * M_PI * frequency / sampleRate;
+
+  for (int s = 0; s < count; s++) {
+    double amplitude = 32767.0 * pow(10.0, segments[s].decibels / 20.0);
+    long frames = lround(segments[s].seconds * sampleRate);
+
+    while (frames > 0) {
+      int n = (frames < BLOCK_FRAMES) ? (int)frames : BLOCK_FRAMES;
+
+      for (int i = 0; i < n; i++) {
+        int16_t sample = (int16_t)lround(amplitude * sin(phase));
+
+        block[2 * i] = sample;
+        block[2 * i + 1] = sample;
+        phase = fmod(phase + step, 2.0 * M_PI);
+      }
+
+      input.feed(block.data(), n * 2 * sizeof(int16_t));
+      frames -= n;
+    }
+  }
+
+  return loudness.read(levels);
+}
+
+static int check(const char* name, float value, float expected, float maxError)
+{
+  int ok = fabsf(value - expected) <= maxError;
+
+  printf("%-40s %7.2f, expected %6.1f +- %.1f %s\n", name, value, expected, maxError, ok ? "ok" : "FAILED");
+
+  return ok ? 0 : 1;
+}
+
+int main()
+{
+  static const long sampleRates[] = { 16000, 44100, 48000 };
+  static const Segment steady[] = { { -23.0f, 20.0f } };
+  static const Segment case3341[] = { { -36.0f, 10.0f }, { -23.0f, 60.0f }, { -36.0f, 10.0f } };
+  static const Segment case3342[] = { { -20.0f, 20.0f }, { -30.0f, 20.0f } };
+  LoudnessLevels levels;
+  char name[64];
+  int failures = 0;
+
+  for (size_t r = 0; r < sizeof(sampleRates) / sizeof(sampleRates[0]); r++) {
+    if (!measure(sampleRates[r], 997.0f, steady, 1, &levels)) {
+      printf("%ld Hz: input() failed\n", sampleRates[r]);
+      failures++;
+      continue;
+    }
+
+    snprintf(name, sizeof(name), "997 Hz -23 dBFS %ld Hz momentary", sampleRates[r]);
+    failures += check(name, levels.momentary, -23.0f, LOUDNESS_MAX_ERROR);
+    snprintf(name, sizeof(name), "997 Hz -23 dBFS %ld Hz short-term", sampleRates[r]);
+    failures += check(name, levels.shortTerm, -23.0f, LOUDNESS_MAX_ERROR);
+    snprintf(name, sizeof(name), "997 Hz -23 dBFS %ld Hz integrated", sampleRates[r]);
+    failures += check(name, levels.integrated, -23.0f, LOUDNESS_MAX_ERROR);
+  }
+
+  if (measure(48000, 1000.0f, case3341, 3, &levels)) {
+    failures += check("Tech 3341 case 3 integrated", levels.integrated, -23.0f, LOUDNESS_MAX_ERROR);
+  } else {
+    failures++;
+  }
+
+  if (measure(48000, 1000.0f, case3342, 2, &levels)) {
+    failures += check("Tech 3342 case 1 loudness range", levels.loudnessRange, 10.0f, RANGE_MAX_ERROR);
+  } else {
+    failures++;
+  }
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
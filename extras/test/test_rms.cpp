@@ -0,0 +1,176 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Compares the RMS kernels of the ESP32 AmplitudeAnalyzer path against a double
+  precision RMS of the same samples and prints the worst error per block length,
+  then the throughput of the kernels on 4096 sample blocks.
+
+  The 16-bit kernel sums exactly and must return the truncated reference. The 32-bit
+  kernel squares the top 24 bits, so it must match 24-bit data in a 32-bit slot to
+  the rounding of the sums, and any other data to the bits it drops.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <vector>
+
+#include "AmplitudeAnalyzer.h"
+
+// worst error of the 16-bit kernel, LSB
+#define INT16_MAX_ERROR 0.0
+// worst relative error of the 32-bit kernel on 24-bit data, besides the truncation to an integer
+#define INT24_MAX_ERROR 1e-9
+// worst relative error of the 32-bit kernel on full 32-bit data
+#define INT32_MAX_ERROR 1e-6
+// samples per benchmarked block, and blocks timed
+#define BENCH_SAMPLES 4096
+#define BENCH_BLOCKS 20000
+
+// the protected kernels made callable
+class HostAmplitude : public AmplitudeAnalyzer
+{
+public:
+  using AmplitudeAnalyzer::rms_16b;
+  using AmplitudeAnalyzer::rms_32b;
+};
+
+static uint32_t seed = 1;
+
+// deterministic samples in [-amplitude, amplitude]
+static double noise(double amplitude)
+{
+  seed = seed * 1664525u + 1013904223u;
+
+  return amplitude * ((double)(seed >> 8) / 8388608.0 - 1.0);
+}
+
+template<typename T> static double reference(const std::vector<T>& samples)
+{
+  double sum = 0.0;
+
+  for (size_t i = 0; i < samples.size(); i++) {
+    sum += (double)samples[i] * (double)samples[i];
+  }
+
+  return sqrt(sum / samples.size());
+}
+
+// full scale noise, or every sample at the negative full scale
+static std::vector<int16_t> samples16(int length, bool fullScale)
+{
+  std::vector<int16_t> samples(length);
+
+  for (int i = 0; i < length; i++) {
+    samples[i] = fullScale ? INT16_MIN : (int16_t)floor(noise(32768.0));
+  }
+
+  return samples;
+}
+
+static std::vector<int32_t> samples32(int length, bool fullScale, int lowBits)
+{
+  std::vector<int32_t> samples(length);
+
+  for (int i = 0; i < length; i++) {
+    samples[i] = fullScale ? INT32_MIN : (int32_t)floor(noise(2147483648.0));
+    samples[i] &= ~((1 << lowBits) - 1);
+  }
+
+  return samples;
+}
+
+static double seconds(std::chrono::steady_clock::time_point start)
+{
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+int main()
+{
+  static const int lengths[] = { 1, 3, 7, 64, 4096, 65537, 200000 };
+  HostAmplitude amplitude;
+  int failures = 0;
+
+  for (size_t l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++) {
+    int length = lengths[l];
+    double int16Error = 0.0;
+    double int24Error = 0.0;
+    double int32Error = 0.0;
+
+    for (int fullScale = 0; fullScale < 2; fullScale++) {
+      std::vector<int16_t> in16 = samples16(length, fullScale);
+      std::vector<int32_t> in24 = samples32(length, fullScale, 8);
+      std::vector<int32_t> in32 = samples32(length, fullScale, 0);
+      int32_t result;
+
+      amplitude.rms_16b(in16.data(), length, &result);
+      int16Error = fmax(int16Error, fabs(result - floor(reference(in16))));
+
+      // the result is clamped to INT32_MAX and truncated
+      double expected = fmin(reference(in24), 2147483647.0);
+
+      amplitude.rms_32b(in24.data(), length, &result);
+      int24Error = fmax(int24Error, fmax(fabs(result - expected) - 1.0, 0.0) / expected);
+
+      expected = fmin(reference(in32), 2147483647.0);
+      amplitude.rms_32b(in32.data(), length, &result);
+      int32Error = fmax(int32Error, fabs(result - expected) / expected);
+    }
+
+    int ok = int16Error <= INT16_MAX_ERROR && int24Error <= INT24_MAX_ERROR && int32Error <= INT32_MAX_ERROR;
+
+    printf("length %6d: int16 %.0f LSB (max %.0f), 24-in-32 %.2e (max %.0e), int32 %.2e (max %.0e) relative %s\n",
+           length, int16Error, INT16_MAX_ERROR, int24Error, INT24_MAX_ERROR, int32Error, INT32_MAX_ERROR,
+           ok ? "ok" : "FAILED");
+
+    if (!ok) {
+      failures++;
+    }
+  }
+
+  std::vector<int16_t> in16 = samples16(BENCH_SAMPLES, false);
+  std::vector<int32_t> in32 = samples32(BENCH_SAMPLES, false, 8);
+  volatile int32_t sink;
+  int32_t result;
+  std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+  for (int b = 0; b < BENCH_BLOCKS; b++) {
+    amplitude.rms_16b(in16.data(), BENCH_SAMPLES, &result);
+    sink = result;
+  }
+
+  double time16 = seconds(start);
+
+  start = std::chrono::steady_clock::now();
+  for (int b = 0; b < BENCH_BLOCKS; b++) {
+    amplitude.rms_32b(in32.data(), BENCH_SAMPLES, &result);
+    sink = result;
+  }
+
+  double time32 = seconds(start);
+
+  (void)sink;
+  printf("%d sample blocks: rms_16b %.2f G samples/s, rms_32b %.2f G samples/s\n",
+         BENCH_SAMPLES, 1e-9 * BENCH_BLOCKS * BENCH_SAMPLES / time16, 1e-9 * BENCH_BLOCKS * BENCH_SAMPLES / time32);
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,205 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+/*
+  Feeds VADAnalyzer a synthetic programme over white noise, at 16 and 48 kHz with the
+  default settings, and checks when speech() turns on and off:
+
+  - a 3 ms click is ignored
+  - voiced bursts with a pause, a fricative 7 dB over the noise and another pause, each
+    pause shorter than the hangover, are one speech period; the fricative is only
+    caught by its zero crossing rate, without it the gap would end the period
+  - a 12 dB noise step holds speech on until the 2 s floor window has caught up,
+    plus the hangover
+
+  The decision code is the same integer code on ESP32 and SAMD.
+*/
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "VADAnalyzer.h"
+#include "host_input.h"
+
+#define NOISE_AMPLITUDE 100.0
+#define VOICED_AMPLITUDE 4000.0
+#define CLICK_AMPLITUDE 20000.0
+#define FRICATIVE_GAIN 7.0 // dB over the noise
+#define STEP_GAIN 12.0
+// speech has to start within this many ms of the programme
+#define ONSET_MAX_DELAY 30
+// and end this long after the hangover has run out, or after the floor window
+#define END_MAX_DELAY 50
+
+static uint32_t seed = 1;
+
+// deterministic samples in [-amplitude, amplitude]
+static double noise(double amplitude)
+{
+  seed = seed * 1664525u + 1013904223u;
+
+  return amplitude * ((double)(seed >> 8) / 8388608.0 - 1.0);
+}
+
+enum Signal {
+  SIGNAL_NOISE,
+  SIGNAL_CLICK,
+  SIGNAL_VOICED, // 150 Hz with two harmonics, over the noise
+  SIGNAL_FRICATIVE,
+  SIGNAL_STEP // louder noise
+};
+
+struct Segment {
+  Signal signal;
+  int milliseconds;
+};
+
+struct Transition {
+  bool speech;
+  int time; // ms
+};
+
+// feeds the segments in 10 ms blocks and records the changes of speech() after each block
+static int run(long sampleRate, const Segment* segments, int count, std::vector<Transition>& transitions)
+{
+  HostInput input(sampleRate, 16, 1);
+  VADAnalyzer vad;
+
+  if (!vad.input(input)) {
+    return 0;
+  }
+
+  int blockFrames = sampleRate / 100;
+  std::vector<int16_t> block(blockFrames);
+  double fricative = pow(10.0, FRICATIVE_GAIN / 20.0);
+  double step = pow(10.0, STEP_GAIN / 20.0);
+  long frame = 0;
+  int time = 0;
+  bool speech = false;
+  int changes = 0;
+
+  for (int s = 0; s < count; s++) {
+    for (int t = 0; t < segments[s].milliseconds; t += 10, time += 10) {
+      for (int i = 0; i < blockFrames; i++, frame++) {
+        double phase = 2.0 * M_PI * 150.0 * frame / sampleRate;
+        double x;
+
+        switch (segments[s].signal) {
+          case SIGNAL_CLICK:
+            x = (t < 3 && i < 3 * sampleRate / 1000) ? CLICK_AMPLITUDE : noise(NOISE_AMPLITUDE);
+            break;
+          case SIGNAL_VOICED:
+            x = VOICED_AMPLITUDE * (sin(phase) + 0.5 * sin(2.0 * phase) + 0.25 * sin(3.0 * phase)) + noise(NOISE_AMPLITUDE);
+            break;
+          case SIGNAL_FRICATIVE:
+            x = noise(fricative * NOISE_AMPLITUDE);
+            break;
+          case SIGNAL_STEP:
+            x = noise(step * NOISE_AMPLITUDE);
+            break;
+          default:
+            x = noise(NOISE_AMPLITUDE);
+            break;
+        }
+
+        block[i] = (int16_t)lround(x);
+      }
+
+      input.feed(block.data(), blockFrames * sizeof(int16_t));
+
+      if (vad.speech() != speech) {
+        speech = vad.speech();
+        transitions.push_back({ speech, time + 10 });
+      }
+    }
+  }
+
+  // every change is counted once
+  changes = vad.available();
+  vad.read();
+
+  return changes == (int)transitions.size();
+}
+
+static int check(long sampleRate)
+{
+  static const Segment programme[] = {
+    { SIGNAL_NOISE, 3000 },
+    { SIGNAL_CLICK, 10 },
+    { SIGNAL_NOISE, 990 },
+    // speech from 4000 to 5000 ms
+    { SIGNAL_VOICED, 300 },
+    { SIGNAL_NOISE, 150 },
+    { SIGNAL_FRICATIVE, 150 },
+    { SIGNAL_NOISE, 100 },
+    { SIGNAL_VOICED, 300 },
+    { SIGNAL_NOISE, 2000 },
+    // step from 7000 ms
+    { SIGNAL_STEP, 4000 }
+  };
+  // on and off windows of the two expected speech periods, ms
+  const int expected[4][2] = {
+    { 4000, 4000 + ONSET_MAX_DELAY },
+    { 5000 + 300, 5000 + 300 + END_MAX_DELAY },
+    { 7000, 7000 + ONSET_MAX_DELAY },
+    { 7000 + 2000 + 300, 7000 + 2250 + 300 + END_MAX_DELAY }
+  };
+  std::vector<Transition> transitions;
+  int failures = 0;
+
+  if (!run(sampleRate, programme, sizeof(programme) / sizeof(programme[0]), transitions)) {
+    printf("%ld Hz: input() failed or available() missed a change FAILED\n", sampleRate);
+    return 1;
+  }
+
+  for (size_t i = 0; i < transitions.size(); i++) {
+    int ok = i < 4 && transitions[i].speech == (i % 2 == 0)
+             && transitions[i].time >= expected[i][0] && transitions[i].time <= expected[i][1];
+
+    if (i < 4) {
+      printf("%ld Hz: speech %s at %5d ms, expected %5d .. %5d %s\n", sampleRate,
+             transitions[i].speech ? "on " : "off", transitions[i].time, expected[i][0], expected[i][1],
+             ok ? "ok" : "FAILED");
+    } else {
+      printf("%ld Hz: speech %s at %5d ms, unexpected FAILED\n", sampleRate,
+             transitions[i].speech ? "on " : "off", transitions[i].time);
+    }
+
+    if (!ok) {
+      failures++;
+    }
+  }
+
+  if (transitions.size() < 4) {
+    printf("%ld Hz: %d changes, expected 4 FAILED\n", sampleRate, (int)transitions.size());
+    failures++;
+  }
+
+  return failures;
+}
+
+int main()
+{
+  int failures = check(16000) + check(48000);
+
+  return failures ? EXIT_FAILURE : EXIT_SUCCESS;
+}
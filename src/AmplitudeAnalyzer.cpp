@@ -20,24 +20,131 @@
 
 #include "AmplitudeAnalyzer.h"
 
+// the window is kept as this many partial sums, its value is refreshed when one completes
+#define WINDOW_SEGMENTS 16
+
+// 32-bit samples are squared from their top 20 bits so the sums fit 64 bits
+#define WINDOW_SHIFT_32B 12
+
+/*
+ * Sums of squares of signed samples, exact in 64 bits. The 16-bit loop is kept in the
+ * plain form compilers vectorize with widening adds; the 32-bit one uses two accumulators
+ * and four samples per iteration to keep the 64-bit multiplies independent. 32-bit samples
+ * are shifted right by shift first, a square of a sample shifted by 8 (24-bit data in a
+ * 32-bit slot) fits 47 bits, 2^17 of them fit the accumulators.
+ */
+static uint64_t sum_squares_16b(const int16_t* buffer, int samples)
+{
+  uint64_t sum = 0;
+
+  for (int i = 0; i < samples; i++) {
+    int32_t in = buffer[i];
+
+    sum += (uint32_t)(in * in);
+  }
+
+  return sum;
+}
+
+static uint64_t sum_squares_32b(const int32_t* buffer, int samples, int shift)
+{
+  uint64_t sum0 = 0;
+  uint64_t sum1 = 0;
+  int i = 0;
+
+  for (; i + 4 <= samples; i += 4) {
+    int64_t in0 = buffer[i] >> shift;
+    int64_t in1 = buffer[i + 1] >> shift;
+    int64_t in2 = buffer[i + 2] >> shift;
+    int64_t in3 = buffer[i + 3] >> shift;
+
+    sum0 += (uint64_t)(in0 * in0) + (uint64_t)(in1 * in1);
+    sum1 += (uint64_t)(in2 * in2) + (uint64_t)(in3 * in3);
+  }
+
+  for (; i < samples; i++) {
+    int64_t in = buffer[i] >> shift;
+
+    sum0 += (uint64_t)(in * in);
+  }
+
+  return sum0 + sum1;
+}
+
 AmplitudeAnalyzer::AmplitudeAnalyzer() :
   _bitsPerSample(-1),
   _available(0),
-  _analysis(0)
+  _analysis(0),
+  _windowDuration(0),
+  _segmentSums(NULL),
+  _segmentSamples(0),
+  _segmentIndex(0),
+  _segmentsFilled(0),
+  _segmentFill(0),
+  _segmentSum(0),
+  _windowSum(0),
+  _segmentPeaks(NULL),
+  _metering(false),
+  _channels(0),
+  _meterHistory(NULL),
+  _meterIndex(0),
+  _meterPeak(0),
+  _meterTruePeak(0)
 {
+  memset(_meterTaps, 0x00, sizeof(_meterTaps));
+  memset(&_levels, 0x00, sizeof(_levels));
 }
 
 AmplitudeAnalyzer::~AmplitudeAnalyzer()
 {
+  detach();
+  freeBuffers();
+}
+
+int AmplitudeAnalyzer::setWindowDuration(int milliseconds)
+{
+  if (_bitsPerSample != -1 || milliseconds < 0) {
+    // the ring is sized by configure()
+    return 0;
+  }
+
+  _windowDuration = milliseconds;
+
+  return 1;
+}
+
+int AmplitudeAnalyzer::setMetering(bool enable)
+{
+  if (_bitsPerSample != -1) {
+    // the interpolation history is allocated by configure()
+    return 0;
+  }
+
+  _metering = enable;
+
+  return 1;
 }
 
 int AmplitudeAnalyzer::available()
 {
+  #ifdef ESP_PLATFORM
+    if (_attachedInput == NULL) {
+      return 0;
+    }
+
+    _attachedInput->read(_data_buffer, sizeof(_data_buffer));
+  #endif
+
   return _available;
 }
 
 int AmplitudeAnalyzer::read()
 {
+  if (_segmentSums) {
+    _available = 0;
+    return _analysis;
+  }
+
   if (_available) {
     _available = 0;
     return _analysis;
@@ -46,14 +153,101 @@ int AmplitudeAnalyzer::read()
   return 0;
 }
 
+int AmplitudeAnalyzer::readLevels(AmplitudeLevels* levels)
+{
+  if (!_metering || _bitsPerSample == -1) {
+    return 0;
+  }
+
+  #ifndef ESP_PLATFORM
+    // the levels are written from the I2S interrupt
+    noInterrupts();
+  #endif
+  *levels = _levels;
+  _available = 0;
+  #ifndef ESP_PLATFORM
+    interrupts();
+  #endif
+
+  return 1;
+}
+
 int AmplitudeAnalyzer::configure(AudioIn* input)
 {
   int bitsPerSample = input->bitsPerSample();
+  int channels = input->channels();
 
   if (bitsPerSample != 16 && bitsPerSample != 32) {
     return 0;
   }
 
+  if (channels != 1 && channels != 2) {
+    return 0;
+  }
+
+  freeBuffers();
+
+  if (_windowDuration > 0) {
+    // the RMS is taken over all the samples of all channels, as for a block,
+    // segments hold whole frames so metering sees complete frames
+    int64_t windowSamples = (int64_t)input->sampleRate() * channels * _windowDuration / 1000;
+    int segmentSamples = (int)((windowSamples + WINDOW_SEGMENTS * channels - 1) / (WINDOW_SEGMENTS * channels)) * channels;
+
+    // a full scale window sum must fit 64 bits: 2^30 or 2^38 per square
+    int64_t maxSamples = (bitsPerSample == 16) ? ((int64_t)1 << 33) : ((int64_t)1 << 25);
+
+    if (segmentSamples <= 0 || (int64_t)segmentSamples * WINDOW_SEGMENTS > maxSamples) {
+      return 0;
+    }
+
+    _segmentSums = (uint64_t*)calloc(WINDOW_SEGMENTS, sizeof(uint64_t));
+
+    if (_segmentSums == NULL) {
+      return 0;
+    }
+
+    if (_metering) {
+      _segmentPeaks = (uint32_t*)calloc(2 * WINDOW_SEGMENTS, sizeof(uint32_t));
+
+      if (_segmentPeaks == NULL) {
+        freeBuffers();
+        return 0;
+      }
+    }
+
+    _segmentSamples = segmentSamples;
+  }
+
+  if (_metering) {
+    _meterHistory = (int16_t*)calloc(channels * 2 * 12, sizeof(int16_t));
+
+    if (_meterHistory == NULL) {
+      freeBuffers();
+      return 0;
+    }
+
+    // Hann windowed sinc over +-6 input samples, the output at 5 + p / 4 samples back
+    // from the newest one; phase 0 would be the input sample itself, it is not filtered
+    for (int p = 1; p <= 3; p++) {
+      float taps[12];
+      float sum = 0.0f;
+
+      for (int j = 0; j < 12; j++) {
+        float t = 5.0f + p / 4.0f - j;
+        float sinc = sinf((float)M_PI * t) / ((float)M_PI * t);
+
+        taps[j] = sinc * (0.5f + 0.5f * cosf((float)M_PI * t / 6.0f));
+        sum += taps[j];
+      }
+
+      for (int j = 0; j < 12; j++) {
+        // unity gain at 0 Hz, the largest sum of absolute taps stays below 2
+        _meterTaps[p - 1][j] = (int16_t)lroundf(16384.0f * taps[j] / sum);
+      }
+    }
+  }
+
+  _channels = channels;
   _bitsPerSample = bitsPerSample;
 
   return 1;
@@ -61,17 +255,41 @@ int AmplitudeAnalyzer::configure(AudioIn* input)
 
 void AmplitudeAnalyzer::update(const void* buffer, size_t size)
 {
-  int analysis = 0;
+  int samples = size / (_bitsPerSample / 8);
+
+  if (_segmentSums) {
+    windowUpdate(buffer, samples);
+    return;
+  }
+
+  if (_metering) {
+    // one pass for the RMS and the peaks, in chunks the 64-bit sums cannot overflow
+    int shift = (_bitsPerSample == 16) ? 0 : 8;
+    double sum = 0.0;
+
+    for (int offset = 0; offset < samples; offset += 65536) {
+      int count = (samples - offset < 65536) ? samples - offset : 65536;
+
+      sum += (double)measure((const uint8_t*)buffer + offset * (_bitsPerSample / 8), count, shift);
+    }
+
+    publishLevels(samples ? sqrt(sum / samples) * (1 << shift) : 0.0, _meterPeak, _meterTruePeak);
+    _meterPeak = 0;
+    _meterTruePeak = 0;
+    return;
+  }
+
+  int32_t analysis = 0;
 
   if (_bitsPerSample == 16) {
     #ifdef ESP_PLATFORM
-	    rms_16b((uint16_t*)buffer,  size / 2, (uint16_t*)&analysis);
+      rms_16b((const int16_t*)buffer, size / 2, &analysis);
     #else
       arm_rms_q15((q15_t*)buffer, size / 2, (q15_t*)&analysis);
     #endif
   } else if (_bitsPerSample == 32) {
     #ifdef ESP_PLATFORM
-      rms_32b((uint32_t*)buffer,  size / 4, (uint32_t*)&analysis);
+      rms_32b((const int32_t*)buffer, size / 4, &analysis);
     #else
       arm_rms_q31((q31_t*)buffer, size / 4, (q31_t*)&analysis);
     #endif
@@ -81,48 +299,294 @@ void AmplitudeAnalyzer::update(const void* buffer, size_t size)
   _available = 1;
 }
 
-#ifdef ESP_PLATFORM
-void AmplitudeAnalyzer::rms_16b(uint16_t* buffer, uint32_t blockSize, uint16_t* analysis){
-  uint32_t sum = 0;		                           /* accumulator */
-  uint16_t in;                                   /* temporary variable to store the input value */
-  uint32_t blkCnt;                               /* loop counter */
+/*
+ * Adds the squares of the block to the current segment, the block may span several segments.
+ * When a segment completes it replaces the oldest one in the ring, the window sum is updated
+ * by the difference and the RMS recomputed, so the cost does not depend on the window length.
+ */
+void AmplitudeAnalyzer::windowUpdate(const void* buffer, int samples)
+{
+  int offset = 0;
 
-  /* Loop over blockSize number of values */
-	blkCnt = blockSize;
+  while (offset < samples) {
+    int count = _segmentSamples - _segmentFill;
 
-	while(blkCnt > 0u)
-	{
-	  /* C = (A[0] * A[0] + A[1] * A[1] + ... + A[blockSize-1] * A[blockSize-1]) */
-	  /* Compute sum of the squares and then store the results in a temporary variable, sum */
-	  in = *buffer++;
-	  sum += (in * in);
+    if (count > samples - offset) {
+      count = samples - offset;
+    }
 
-	  /* Decrement the loop counter */
-	  blkCnt--;
-	}
+    int shift = (_bitsPerSample == 16) ? 0 : WINDOW_SHIFT_32B;
 
-	*analysis = (uint16_t)sqrt(sum / blockSize);
+    _segmentSum += measure((const uint8_t*)buffer + offset * (_bitsPerSample / 8), count, shift);
+
+    offset += count;
+    _segmentFill += count;
+
+    if (_segmentFill < _segmentSamples) {
+      break;
+    }
+
+    _windowSum += _segmentSum;
+    _windowSum -= _segmentSums[_segmentIndex];
+    _segmentSums[_segmentIndex] = _segmentSum;
+
+    if (++_segmentIndex == WINDOW_SEGMENTS) {
+      _segmentIndex = 0;
+    }
+
+    if (_segmentsFilled < WINDOW_SEGMENTS) {
+      _segmentsFilled++;
+    }
+
+    _segmentSum = 0;
+    _segmentFill = 0;
+
+    // until the ring is full the RMS covers the segments seen so far
+    double meanSquare = (double)_windowSum / ((double)_segmentsFilled * _segmentSamples);
+    double rms = sqrt(meanSquare);
+
+    if (_bitsPerSample == 32) {
+      rms *= (double)(1 << WINDOW_SHIFT_32B);
+    }
+
+    if (_segmentPeaks) {
+      // the slot just written is the newest segment
+      int slot = (_segmentIndex + WINDOW_SEGMENTS - 1) % WINDOW_SEGMENTS;
+      uint32_t peak = 0;
+      uint32_t truePeak = 0;
+
+      _segmentPeaks[2 * slot] = _meterPeak;
+      _segmentPeaks[2 * slot + 1] = _meterTruePeak;
+      _meterPeak = 0;
+      _meterTruePeak = 0;
+
+      for (int i = 0; i < WINDOW_SEGMENTS; i++) {
+        if (_segmentPeaks[2 * i] > peak) {
+          peak = _segmentPeaks[2 * i];
+        }
+        if (_segmentPeaks[2 * i + 1] > truePeak) {
+          truePeak = _segmentPeaks[2 * i + 1];
+        }
+      }
+
+      publishLevels(rms, peak, truePeak);
+      continue;
+    }
+
+    // a single int store, read() may run between two interrupts
+    _analysis = (int)(rms < 2147483647.0 ? rms : 2147483647.0);
+    _available = 1;
+  }
+}
+
+// sum of squares of samples, whole frames, with metering also the running peak and true peak
+uint64_t AmplitudeAnalyzer::measure(const void* buffer, int samples, int shift)
+{
+  if (_meterHistory) {
+    if (_bitsPerSample == 16) {
+      return meter_16b((const int16_t*)buffer, samples);
+    }
+
+    return meter_32b((const int32_t*)buffer, samples, shift);
+  }
+
+  if (_bitsPerSample == 16) {
+    return sum_squares_16b((const int16_t*)buffer, samples);
+  }
+
+  return sum_squares_32b((const int32_t*)buffer, samples, shift);
+}
+
+/*
+ * The fused metering pass, for each sample:
+ * 1. add its square to the sum and track the highest absolute value
+ * 2. append it to the history of its channel and interpolate the 3 points between it and the
+ *    previous sample, 5 samples back, with the 12 taps of each phase (polyphase 4x upsampling
+ *    as in ITU-R BS.1770 annex 2), tracking the highest absolute interpolated value
+ */
+uint64_t AmplitudeAnalyzer::meter_16b(const int16_t* buffer, int samples)
+{
+  uint64_t sum = 0;
+  uint32_t peak = _meterPeak;
+  uint32_t truePeak = _meterTruePeak;
+  int index = _meterIndex;
+
+  for (int i = 0; i < samples; i += _channels) {
+    for (int c = 0; c < _channels; c++) {
+      int32_t in = buffer[i + c];
+      uint32_t magnitude = (in < 0) ? -in : in;
+      int16_t* history = _meterHistory + c * 24;
+
+      sum += (uint32_t)(in * in);
+
+      if (magnitude > peak) {
+        peak = magnitude;
+      }
+
+      history[index] = history[index + 12] = (int16_t)in;
+
+      // oldest to newest sample
+      const int16_t* window = history + index + 1;
+
+      for (int p = 0; p < 3; p++) {
+        const int16_t* taps = _meterTaps[p];
+        int32_t acc = 0;
+
+        for (int j = 0; j < 12; j++) {
+          acc += taps[j] * window[j];
+        }
+
+        uint32_t value = (uint32_t)((acc < 0) ? -acc : acc) >> 14;
+
+        if (value > truePeak) {
+          truePeak = value;
+        }
+      }
+    }
+
+    if (++index == 12) {
+      index = 0;
+    }
+  }
+
+  _meterIndex = index;
+  _meterPeak = peak;
+  _meterTruePeak = truePeak;
+
+  return sum;
 }
 
-void AmplitudeAnalyzer::rms_32b(uint32_t* buffer, uint32_t blockSize, uint32_t* analysis){
-  uint64_t sum = 0;                              /* accumulator */
-  uint32_t in;                                   /* temporary variable to store the input value */
-  uint32_t blkCnt;                               /* loop counter */
+// as meter_16b(), the interpolation runs on the top 16 bits of the samples
+uint64_t AmplitudeAnalyzer::meter_32b(const int32_t* buffer, int samples, int shift)
+{
+  uint64_t sum = 0;
+  uint32_t peak = _meterPeak;
+  uint32_t truePeak = _meterTruePeak;
+  int index = _meterIndex;
+
+  for (int i = 0; i < samples; i += _channels) {
+    for (int c = 0; c < _channels; c++) {
+      int32_t in = buffer[i + c];
+      int64_t reduced = in >> shift;
+      uint32_t magnitude = (in < 0) ? 0u - (uint32_t)in : (uint32_t)in;
+      int16_t* history = _meterHistory + c * 24;
+
+      sum += (uint64_t)(reduced * reduced);
+
+      if (magnitude > peak) {
+        peak = magnitude;
+      }
+
+      history[index] = history[index + 12] = (int16_t)(in >> 16);
+
+      const int16_t* window = history + index + 1;
+
+      for (int p = 0; p < 3; p++) {
+        const int16_t* taps = _meterTaps[p];
+        int32_t acc = 0;
+
+        for (int j = 0; j < 12; j++) {
+          acc += taps[j] * window[j];
+        }
+
+        // back to 32-bit sample units, saturated
+        uint32_t value = (uint32_t)((acc < 0) ? -acc : acc) >> 14;
+        uint32_t scaled = (value > 0xffff) ? 0xffffffffu : (value << 16);
+
+        if (scaled > truePeak) {
+          truePeak = scaled;
+        }
+      }
+    }
+
+    if (++index == 12) {
+      index = 0;
+    }
+  }
+
+  _meterIndex = index;
+  _meterPeak = peak;
+  _meterTruePeak = truePeak;
+
+  return sum;
+}
+
+void AmplitudeAnalyzer::publishLevels(double rms, uint32_t peak, uint32_t truePeak)
+{
+  AmplitudeLevels levels;
+
+  levels.rms = (float)rms;
+  levels.peak = (float)peak;
+  // the interpolated points do not include the samples themselves
+  levels.truePeak = (float)((truePeak > peak) ? truePeak : peak);
+  levels.crestFactor = (rms > 0.0) ? (float)(peak / rms) : 0.0f;
+
+  _levels = levels;
+  _analysis = (int)(rms < 2147483647.0 ? rms : 2147483647.0);
+  _available = 1;
+}
+
+void AmplitudeAnalyzer::freeBuffers()
+{
+  if (_segmentSums) {
+    free(_segmentSums);
+    _segmentSums = NULL;
+  }
+
+  if (_segmentPeaks) {
+    free(_segmentPeaks);
+    _segmentPeaks = NULL;
+  }
+
+  if (_meterHistory) {
+    free(_meterHistory);
+    _meterHistory = NULL;
+  }
+
+  _segmentIndex = 0;
+  _segmentsFilled = 0;
+  _segmentFill = 0;
+  _segmentSum = 0;
+  _windowSum = 0;
+  _meterIndex = 0;
+  _meterPeak = 0;
+  _meterTruePeak = 0;
+}
 
-  /* Loop over blockSize number of values */
-  blkCnt = blockSize;
+#ifdef ESP_PLATFORM
+// the esp-dsp dot products return a saturated 16-bit result, too narrow for a sum of squares
+void AmplitudeAnalyzer::rms_16b(const int16_t* buffer, uint32_t blockSize, int32_t* analysis){
+  if (blockSize == 0) {
+    *analysis = 0;
+    return;
+  }
+
+  uint64_t sum = sum_squares_16b(buffer, blockSize);
+
+  *analysis = (int32_t)sqrt((double)sum / blockSize);
+}
 
-  while(blkCnt > 0u)
-  {
-    /* C = (A[0] * A[0] + A[1] * A[1] + ... + A[blockSize-1] * A[blockSize-1]) */
-    /* Compute sum of the squares and then store the results in a temporary variable, sum */
-    in = *buffer++;
-    sum += (in * in);
+// squares the 24 significant bits of the samples, in chunks the 64-bit sums cannot overflow
+void AmplitudeAnalyzer::rms_32b(const int32_t* buffer, uint32_t blockSize, int32_t* analysis){
+  if (blockSize == 0) {
+    *analysis = 0;
+    return;
+  }
+
+  double sum = 0.0;
+
+  for (uint32_t offset = 0; offset < blockSize; offset += 65536u) {
+    uint32_t count = blockSize - offset;
 
-    /* Decrement the loop counter */
-    blkCnt--;
+    if (count > 65536u) {
+      count = 65536u;
+    }
+
+    sum += (double)sum_squares_32b(buffer + offset, count, 8);
   }
 
-  *analysis = (uint16_t)sqrt(sum / blockSize);
+  double rms = sqrt(sum / blockSize) * 256.0;
+
+  *analysis = (int32_t)(rms < 2147483647.0 ? rms : 2147483647.0);
 }
 #endif
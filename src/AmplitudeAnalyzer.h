@@ -30,27 +30,73 @@
 
 #include "AudioAnalyzer.h"
 
+struct AmplitudeLevels {
+  float rms; // sample units, as read()
+  float peak; // highest absolute sample
+  float truePeak; // highest absolute value of the 4x oversampled signal, at least peak
+  float crestFactor; // peak / rms, 0 for silence
+};
+
 class AmplitudeAnalyzer : public AudioAnalyzer
 {
 public:
   AmplitudeAnalyzer();
   virtual ~AmplitudeAnalyzer();
 
+  // RMS over the last milliseconds of input instead of over each block read,
+  // independent of the buffer size, 0 (the default) turns it off. Call before input()
+  int setWindowDuration(int milliseconds);
+  // also measure the peak, the true peak and the crest factor, in the same pass over the
+  // samples as the RMS; over each block or over the window duration. Call before input()
+  int setMetering(bool enable);
+
   int available();
-  int read();
+  int read(); // RMS in sample units, with a window duration it is kept current and can be read at any time
+  int readLevels(AmplitudeLevels* levels); // newest levels with metering on, clears available() as read() does
 
 protected:
   virtual int configure(AudioIn* input);
   virtual void update(const void* buffer, size_t size);
   #ifdef ESP_PLATFORM
-    void rms_16b(uint16_t* buffer, uint32_t blockSize, uint16_t* analysis);
-    void rms_32b(uint32_t* buffer, uint32_t blockSize, uint32_t* analysis);
+    void rms_16b(const int16_t* buffer, uint32_t blockSize, int32_t* analysis);
+    void rms_32b(const int32_t* buffer, uint32_t blockSize, int32_t* analysis);
   #endif
 
+private:
+  void windowUpdate(const void* buffer, int samples);
+  uint64_t measure(const void* buffer, int samples, int shift);
+  uint64_t meter_16b(const int16_t* buffer, int samples);
+  uint64_t meter_32b(const int32_t* buffer, int samples, int shift);
+  void publishLevels(double rms, uint32_t peak, uint32_t truePeak);
+  void freeBuffers();
+
 private:
   int _bitsPerSample;
   int _available;
   int _analysis;
+
+  int _windowDuration;
+  uint64_t* _segmentSums; // ring of the sums of squares of the last window segments
+  int _segmentSamples;
+  int _segmentIndex; // oldest segment in the ring
+  int _segmentsFilled;
+  int _segmentFill; // samples in the current segment
+  uint64_t _segmentSum; // current segment
+  uint64_t _windowSum; // complete segments in the ring
+  uint32_t* _segmentPeaks; // peak and true peak of each segment in the ring, metering only
+
+  bool _metering;
+  int _channels;
+  int16_t _meterTaps[3][12]; // Q14 interpolation filter of the 1/4, 2/4 and 3/4 phases
+  int16_t* _meterHistory; // last 12 samples of each channel, stored twice so the taps read them in one run
+  int _meterIndex;
+  uint32_t _meterPeak; // since the last block or segment
+  uint32_t _meterTruePeak;
+  AmplitudeLevels _levels;
+
+  #ifdef ESP_PLATFORM
+    uint8_t _data_buffer[256];
+  #endif
 };
 
 #endif
@@ -29,6 +29,16 @@
 #include "AudioInI2S.h"
 #include "AudioOutI2S.h"
 #include "FFTAnalyzer.h"
+#include "StaticFFTAnalyzer.h"
+#include "GoertzelAnalyzer.h"
+#include "SlidingDFTAnalyzer.h"
+#include "MelFeatureAnalyzer.h"
+#include "PitchAnalyzer.h"
+#include "OnsetAnalyzer.h"
+#include "OctaveBandAnalyzer.h"
+#include "LoudnessAnalyzer.h"
+#include "EnvelopeAnalyzer.h"
+#include "VADAnalyzer.h"
 #include "SDWaveFile.h"
 
 #if defined ESP_PLATFORM
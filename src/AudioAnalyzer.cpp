@@ -18,7 +18,40 @@
 
 #include "AudioAnalyzer.h"
 
+AudioAnalyzer::AudioAnalyzer() :
+  _attachedInput(NULL)
+{
+}
+
+AudioAnalyzer::~AudioAnalyzer()
+{
+  // a no-op when the derived destructor has detached already
+  detach();
+}
+
 int AudioAnalyzer::input(AudioIn& input)
 {
-  return input.setAnalyzer(this);
+  if (_attachedInput) {
+    return 0;
+  }
+
+  if (!input.setAnalyzer(this)) {
+    return 0;
+  }
+
+  _attachedInput = &input;
+
+  return 1;
+}
+
+int AudioAnalyzer::detach()
+{
+  if (_attachedInput == NULL) {
+    return 0;
+  }
+
+  _attachedInput->removeAnalyzer(this);
+  _attachedInput = NULL;
+
+  return 1;
 }
@@ -26,13 +26,23 @@
 class AudioAnalyzer
 {
 public:
+  AudioAnalyzer();
+  virtual ~AudioAnalyzer();
+
+  // an input feeds up to AUDIO_IN_MAX_ANALYZERS analyzers, an analyzer takes one input
   int input(AudioIn& input);
+  // stops the updates from the input, input() can attach it again; destroying the analyzer detaches it
+  int detach();
 
 protected:
   friend class AudioIn;
 
+  // an analyzer destructor calls detach() before it frees anything: by the time this
+  // destructor runs, update() is pure virtual again and the derived buffers are gone
   virtual int configure(AudioIn* input) = 0;
   virtual void update(const void* buffer, size_t size) = 0;
+
+  AudioIn* _attachedInput; // NULL while detached, on ESP32 available() reads it
 };
 
 #endif
@@ -19,10 +19,10 @@
 #include "AudioAnalyzer.h"
 
 #include "AudioIn.h"
-#include "Arduino.h"// only for debug prints
+#include "Arduino.h"
 
 AudioIn::AudioIn() :
-  _analyzer(NULL)
+  _analyzerCount(0)
   #if defined ESP_PLATFORM
    , _esp32_i2s_port_number(0)
   #endif
@@ -32,27 +32,69 @@ AudioIn::AudioIn() :
 AudioIn::~AudioIn()
 
 {
+  for (int i = 0; i < _analyzerCount; i++) {
+    _analyzers[i]->_attachedInput = NULL;
+  }
 }
 
 int AudioIn::setAnalyzer(AudioAnalyzer* analyzer)
 {
-  if (_analyzer) {
+  if (_analyzerCount == AUDIO_IN_MAX_ANALYZERS) {
     return 0;
   }
 
+  for (int i = 0; i < _analyzerCount; i++) {
+    if (_analyzers[i] == analyzer) {
+      return 0;
+    }
+  }
+
   if (!analyzer->configure(this)) {
     return 0;
   }
 
-  _analyzer = analyzer;
+  #ifndef ESP_PLATFORM
+    // samplesRead() runs from the I2S interrupt
+    noInterrupts();
+  #endif
+  _analyzers[_analyzerCount++] = analyzer;
+  #ifndef ESP_PLATFORM
+    interrupts();
+  #endif
 
   return 1;
 }
 
+int AudioIn::removeAnalyzer(AudioAnalyzer* analyzer)
+{
+  int removed = 0;
+
+  #ifndef ESP_PLATFORM
+    noInterrupts();
+  #endif
+  for (int i = 0; i < _analyzerCount; i++) {
+    if (_analyzers[i] == analyzer) {
+      // keep the order of the others
+      for (int j = i + 1; j < _analyzerCount; j++) {
+        _analyzers[j - 1] = _analyzers[j];
+      }
+
+      _analyzerCount--;
+      removed = 1;
+      break;
+    }
+  }
+  #ifndef ESP_PLATFORM
+    interrupts();
+  #endif
+
+  return removed;
+}
+
 void AudioIn::samplesRead(void* buffer, size_t size)
 {
-  if (_analyzer) {
-    _analyzer->update(buffer, size);
+  for (int i = 0; i < _analyzerCount; i++) {
+    _analyzers[i]->update(buffer, size);
   }
 }
 
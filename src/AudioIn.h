@@ -21,6 +21,9 @@
 
 #include <stddef.h>
 
+// analyzers one input feeds at the same time
+#define AUDIO_IN_MAX_ANALYZERS 4
+
 class AudioOut;
 class AudioAnalyzer;
 
@@ -40,6 +43,7 @@ public:
 
 
 protected:
+  // hands the block to every analyzer, all of them get the same buffer
   void samplesRead(void* buffer, size_t size);
 
 protected:
@@ -51,11 +55,13 @@ protected:
 
 protected:
   friend class AudioAnalyzer;
-  int setAnalyzer(AudioAnalyzer* analyzer);
+  int setAnalyzer(AudioAnalyzer* analyzer); // adds analyzer to the list
+  int removeAnalyzer(AudioAnalyzer* analyzer);
   int _channels;
 
 private:
-  AudioAnalyzer* _analyzer;
+  AudioAnalyzer* _analyzers[AUDIO_IN_MAX_ANALYZERS];
+  int _analyzerCount;
 
 #ifdef ESP_PLATFORM
 protected:
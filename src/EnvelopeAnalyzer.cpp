@@ -0,0 +1,393 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "AudioIn.h"
+
+#include "EnvelopeAnalyzer.h"
+
+#define FLOOR_SUB_WINDOWS (int)(sizeof(_minima) / sizeof(_minima[0]))
+#define ENVELOPE_EVENTS (int)(sizeof(_events) / sizeof(_events[0]))
+
+// one LSB squared, the lowest floor the crossings are relative to
+#ifdef ESP_PLATFORM
+  #define MIN_FLOOR 1.0f
+#else
+  #define MIN_FLOOR 256 // mean squares are Q8
+#endif
+
+// one pole smoothing coefficient of a time constant in milliseconds
+static float smoothing_coefficient(float milliseconds, long sampleRate)
+{
+  if (milliseconds <= 0.0f) {
+    return 1.0f;
+  }
+
+  return 1.0f - expf(-1000.0f / (milliseconds * sampleRate));
+}
+
+EnvelopeAnalyzer::EnvelopeAnalyzer() :
+  _attack(5.0f),
+  _release(100.0f),
+  _floorWindow(2000),
+  _threshold(12.0f),
+  _hysteresis(3.0f),
+  _bitsPerSample(-1),
+  _channels(-1),
+  _sampleRate(0),
+  _frames(0),
+  _subWindowSize(0),
+  _subWindowFrames(0),
+  _minimumIndex(0),
+  _minimumCount(0),
+  _above(false),
+  _attackCoefficient(0),
+  _releaseCoefficient(0),
+  _peak(0),
+  _meanSquare(0),
+  _minimum(0),
+  _floor(0),
+  _onLevel(0),
+  _offLevel(0),
+  _eventIndex(0),
+  _eventCount(0)
+{
+  memset(_minima, 0x00, sizeof(_minima));
+}
+
+EnvelopeAnalyzer::~EnvelopeAnalyzer()
+{
+  detach();
+}
+
+int EnvelopeAnalyzer::setBallistics(float attack, float release)
+{
+  if (_bitsPerSample != -1 || attack < 0.0f || release < 0.0f) {
+    // the coefficients depend on the sample rate, they are computed by configure()
+    return 0;
+  }
+
+  _attack = attack;
+  _release = release;
+
+  return 1;
+}
+
+int EnvelopeAnalyzer::setNoiseFloorWindow(int milliseconds)
+{
+  if (_bitsPerSample != -1 || milliseconds <= 0) {
+    return 0;
+  }
+
+  _floorWindow = milliseconds;
+
+  return 1;
+}
+
+void EnvelopeAnalyzer::setThreshold(float decibels, float hysteresis)
+{
+  #ifndef ESP_PLATFORM
+    // the crossing levels are used from the I2S interrupt
+    noInterrupts();
+  #endif
+  _threshold = decibels;
+  _hysteresis = hysteresis;
+  updateLevels();
+  #ifndef ESP_PLATFORM
+    interrupts();
+  #endif
+}
+
+int EnvelopeAnalyzer::available()
+{
+  #ifdef ESP_PLATFORM
+    if (_attachedInput == NULL) {
+      return 0;
+    }
+
+    _attachedInput->read(_data_buffer, sizeof(_data_buffer));
+  #endif
+
+  return _eventCount;
+}
+
+int EnvelopeAnalyzer::read(EnvelopeEvent events[], int size)
+{
+  int count = 0;
+
+  #ifndef ESP_PLATFORM
+    noInterrupts();
+  #endif
+  while (count < size && _eventCount > 0) {
+    events[count++] = _events[_eventIndex];
+
+    _eventIndex = (_eventIndex + 1) % ENVELOPE_EVENTS;
+    _eventCount--;
+  }
+  #ifndef ESP_PLATFORM
+    interrupts();
+  #endif
+
+  return count;
+}
+
+float EnvelopeAnalyzer::peak()
+{
+  #ifdef ESP_PLATFORM
+    return _peak;
+  #else
+    // 16-bit units in Q15, 32-bit input was reduced to its top 16 bits
+    float scale = (_bitsPerSample == 32) ? 2.0f : (1.0f / 32768.0f);
+
+    return _peak * scale;
+  #endif
+}
+
+float EnvelopeAnalyzer::rms()
+{
+  #ifdef ESP_PLATFORM
+    return sqrtf(_meanSquare);
+  #else
+    noInterrupts();
+    int64_t meanSquare = _meanSquare;
+    interrupts();
+
+    float scale = (_bitsPerSample == 32) ? 65536.0f : 1.0f;
+
+    return sqrtf(meanSquare / 256.0f) * scale;
+  #endif
+}
+
+float EnvelopeAnalyzer::noiseFloor()
+{
+  #ifdef ESP_PLATFORM
+    return sqrtf(_floor);
+  #else
+    noInterrupts();
+    int64_t floor = _floor;
+    interrupts();
+
+    float scale = (_bitsPerSample == 32) ? 65536.0f : 1.0f;
+
+    return sqrtf(floor / 256.0f) * scale;
+  #endif
+}
+
+int EnvelopeAnalyzer::configure(AudioIn* input)
+{
+  int bitsPerSample = input->bitsPerSample();
+  int channels = input->channels();
+  long sampleRate = input->sampleRate();
+
+  if (bitsPerSample != 16 && bitsPerSample != 32) {
+    return 0;
+  }
+
+  if (channels != 1 && channels != 2) {
+    return 0;
+  }
+
+  int subWindowSize = (int)((int64_t)sampleRate * _floorWindow / (1000 * FLOOR_SUB_WINDOWS));
+
+  if (sampleRate <= 0 || subWindowSize <= 0) {
+    return 0;
+  }
+
+  float attack = smoothing_coefficient(_attack, sampleRate);
+  float release = smoothing_coefficient(_release, sampleRate);
+
+  #ifdef ESP_PLATFORM
+    _attackCoefficient = attack;
+    _releaseCoefficient = release;
+    _peak = 0.0f;
+    _meanSquare = 0.0f;
+    _minimum = INFINITY;
+    _floor = 0.0f;
+  #else
+    _attackCoefficient = (int32_t)(attack * 16777216.0f);
+    _releaseCoefficient = (int32_t)(release * 16777216.0f);
+    _peak = 0;
+    _meanSquare = 0;
+    _minimum = INT64_MAX;
+    _floor = 0;
+  #endif
+
+  _bitsPerSample = bitsPerSample;
+  _channels = channels;
+  _sampleRate = sampleRate;
+  _frames = 0;
+  _subWindowSize = subWindowSize;
+  _subWindowFrames = 0;
+  _minimumIndex = 0;
+  _minimumCount = 0;
+  _above = false;
+  _eventIndex = 0;
+  _eventCount = 0;
+
+  updateLevels();
+
+  return 1;
+}
+
+/*
+ * For every frame of the downmixed input:
+ * 1. move the peak envelope towards |x| and the mean square envelope towards x^2, with the
+ *    attack coefficient when rising and the release coefficient when falling
+ * 2. track the lowest mean square of the sub-window for the noise floor
+ * 3. compare the mean square with the crossing levels, once a floor is known
+ */
+void EnvelopeAnalyzer::update(const void* buffer, size_t size)
+{
+  if (_bitsPerSample == -1) {
+    return;
+  }
+
+  int frames = size / (_bitsPerSample / 8) / _channels;
+
+  for (int i = 0; i < frames; i++) {
+    #ifdef ESP_PLATFORM
+      float x;
+
+      if (_bitsPerSample == 16) {
+        const int16_t* src = (const int16_t*)buffer + i * _channels;
+
+        x = (_channels == 2) ? 0.5f * ((float)src[0] + (float)src[1]) : (float)src[0];
+      } else {
+        const int32_t* src = (const int32_t*)buffer + i * _channels;
+
+        x = (_channels == 2) ? 0.5f * ((float)src[0] + (float)src[1]) : (float)src[0];
+      }
+
+      float magnitude = fabsf(x);
+      float square = x * x;
+
+      _peak += ((magnitude > _peak) ? _attackCoefficient : _releaseCoefficient) * (magnitude - _peak);
+      _meanSquare += ((square > _meanSquare) ? _attackCoefficient : _releaseCoefficient) * (square - _meanSquare);
+    #else
+      int32_t x;
+
+      if (_bitsPerSample == 16) {
+        const int16_t* src = (const int16_t*)buffer + i * _channels;
+
+        x = (_channels == 2) ? ((int32_t)src[0] + src[1]) >> 1 : src[0];
+      } else {
+        const int32_t* src = (const int32_t*)buffer + i * _channels;
+
+        x = (_channels == 2) ? ((src[0] >> 16) + (src[1] >> 16)) >> 1 : src[0] >> 16;
+      }
+
+      int32_t magnitude = ((x < 0) ? -x : x) << 15;
+      int64_t square = (int64_t)(x * x) << 8;
+
+      int32_t coefficient = (magnitude > _peak) ? _attackCoefficient : _releaseCoefficient;
+
+      _peak += (int32_t)(((int64_t)coefficient * (magnitude - _peak)) >> 24);
+
+      coefficient = (square > _meanSquare) ? _attackCoefficient : _releaseCoefficient;
+      _meanSquare += (coefficient * (square - _meanSquare)) >> 24;
+    #endif
+
+    _frames++;
+
+    if (_meanSquare < _minimum) {
+      _minimum = _meanSquare;
+    }
+
+    if (_minimumCount > 0) {
+      if (!_above && _meanSquare > _onLevel) {
+        _above = true;
+        queueEvent(true, _meanSquare);
+      } else if (_above && _meanSquare < _offLevel) {
+        _above = false;
+        queueEvent(false, _meanSquare);
+      }
+    }
+
+    if (++_subWindowFrames == _subWindowSize) {
+      finishSubWindow();
+    }
+  }
+}
+
+// the floor is the lowest of the last 8 sub-window minima
+void EnvelopeAnalyzer::finishSubWindow()
+{
+  // the first sub-window only lets the envelopes rise from 0
+  if (_frames > (uint32_t)_subWindowSize) {
+    _minima[_minimumIndex] = _minimum;
+    _minimumIndex = (_minimumIndex + 1) % FLOOR_SUB_WINDOWS;
+
+    if (_minimumCount < FLOOR_SUB_WINDOWS) {
+      _minimumCount++;
+    }
+
+    _floor = _minima[0];
+
+    for (int i = 1; i < _minimumCount; i++) {
+      if (_minima[i] < _floor) {
+        _floor = _minima[i];
+      }
+    }
+  }
+
+  #ifdef ESP_PLATFORM
+    _minimum = INFINITY;
+  #else
+    _minimum = INT64_MAX;
+  #endif
+  _subWindowFrames = 0;
+
+  updateLevels();
+}
+
+// mean square levels of the crossings, relative to the floor
+void EnvelopeAnalyzer::updateLevels()
+{
+  float on = powf(10.0f, _threshold / 10.0f);
+  float off = powf(10.0f, (_threshold - _hysteresis) / 10.0f);
+
+  // a digital silence floor still needs a crossing level above 0
+  #ifdef ESP_PLATFORM
+    float floor = (_floor > MIN_FLOOR) ? _floor : MIN_FLOOR;
+
+    _onLevel = floor * on;
+    _offLevel = floor * off;
+  #else
+    int64_t floor = (_floor > MIN_FLOOR) ? _floor : MIN_FLOOR;
+
+    _onLevel = (int64_t)((float)floor * on);
+    _offLevel = (int64_t)((float)floor * off);
+  #endif
+}
+
+void EnvelopeAnalyzer::queueEvent(bool rising, float level)
+{
+  int slot = (_eventIndex + _eventCount) % ENVELOPE_EVENTS;
+
+  if (_eventCount == ENVELOPE_EVENTS) {
+    _eventIndex = (_eventIndex + 1) % ENVELOPE_EVENTS;
+  } else {
+    _eventCount++;
+  }
+
+  float floor = (_floor > MIN_FLOOR) ? (float)_floor : (float)MIN_FLOOR;
+
+  _events[slot].frame = _frames;
+  _events[slot].time = (uint32_t)((uint64_t)_frames * 1000 / _sampleRate);
+  _events[slot].rising = rising;
+  _events[slot].level = 10.0f * log10f(level / floor);
+}
@@ -0,0 +1,120 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef _ENVELOPE_ANALYZER_H_INCLUDED
+#define _ENVELOPE_ANALYZER_H_INCLUDED
+
+#include <Arduino.h>
+
+#include "AudioAnalyzer.h"
+
+struct EnvelopeEvent {
+  uint32_t frame; // input frames since input() at the crossing
+  uint32_t time; // the same position in milliseconds
+  bool rising; // true when the RMS envelope rose above the threshold, false when it fell back below
+  float level; // RMS envelope over the noise floor in dB
+};
+
+/*
+ * Envelope follower of the downmixed input. Every sample updates a peak and
+ * an RMS (mean square) envelope, each rising with the attack and falling
+ * with the release time constant. The noise floor is the minimum of the RMS
+ * envelope over the floor window, kept as the minima of 8 sub-windows, so it
+ * follows the room noise up and down within one window.
+ *
+ * An event is queued when the RMS envelope rises threshold dB above the
+ * floor, and when it falls back below threshold - hysteresis dB, so sketches
+ * read crossings instead of polling levels.
+ *
+ * On ESP32 the envelopes are float, on SAMD fixed point.
+ */
+class EnvelopeAnalyzer : public AudioAnalyzer
+{
+public:
+  EnvelopeAnalyzer();
+  virtual ~EnvelopeAnalyzer();
+
+  // time constants in milliseconds, the defaults are 5 ms and 100 ms. Call before input()
+  int setBallistics(float attack, float release);
+  // duration the noise floor minimum is taken over, 2000 ms by default. Call before input()
+  int setNoiseFloorWindow(int milliseconds);
+  // crossing levels in dB above the noise floor, 12 dB and 3 dB by default
+  void setThreshold(float decibels, float hysteresis = 3.0f);
+
+  int available(); // number of events waiting to be read, the newest 8 are kept
+  int read(EnvelopeEvent events[], int size);
+
+  // the current envelopes and floor in sample units, they can be read at any time
+  float peak();
+  float rms();
+  float noiseFloor(); // 0 until the second sub-window is complete, the first one lets the envelopes settle
+
+protected:
+  virtual int configure(AudioIn* input);
+  virtual void update(const void* buffer, size_t size);
+
+private:
+  void finishSubWindow();
+  void updateLevels();
+  void queueEvent(bool rising, float level);
+
+private:
+  float _attack;
+  float _release;
+  int _floorWindow;
+  float _threshold;
+  float _hysteresis;
+  int _bitsPerSample;
+  int _channels;
+  long _sampleRate;
+  uint32_t _frames;
+  int _subWindowSize; // frames of a noise floor sub-window
+  int _subWindowFrames;
+  int _minimumIndex;
+  int _minimumCount; // sub-windows in the ring, up to 8
+  bool _above;
+
+  #ifdef ESP_PLATFORM
+    float _attackCoefficient;
+    float _releaseCoefficient;
+    float _peak;
+    float _meanSquare;
+    float _minimum; // of the current sub-window
+    float _minima[8];
+    float _floor; // mean square
+    float _onLevel; // mean square levels of the crossings
+    float _offLevel;
+    uint8_t _data_buffer[256];
+  #else
+    int32_t _attackCoefficient; // Q24
+    int32_t _releaseCoefficient;
+    int32_t _peak; // |x| << 15, 16-bit samples
+    int64_t _meanSquare; // x^2 << 8
+    int64_t _minimum;
+    int64_t _minima[8];
+    int64_t _floor;
+    int64_t _onLevel;
+    int64_t _offLevel;
+  #endif
+
+  EnvelopeEvent _events[8]; // ring of pending events
+  int _eventIndex; // oldest pending event
+  int _eventCount;
+};
+
+#endif
@@ -18,55 +18,315 @@
 
 #include "AudioIn.h"
 #include "FFTAnalyzer.h"
+#include "FFTSplit.h"
+
+#include <Arduino.h>
+#include <float.h>
+
+// log2(x) from the float exponent and a polynomial of the mantissa, about 2e-4 error,
+// much cheaper than log10f() on both the ESP32 FPU and the soft float SAMD21
+static inline float fast_log2f(float x)
+{
+  if (!(x > FLT_MIN)) {
+    x = FLT_MIN;
+  }
+
+  uint32_t bits;
+  memcpy(&bits, &x, sizeof(bits));
+
+  int exponent = (int)((bits >> 23) & 0xff) - 127;
+  bits = (bits & 0x007fffff) | 0x3f800000;
+
+  float m;
+  memcpy(&m, &bits, sizeof(m)); // mantissa in [1, 2)
+
+  return exponent + (-2.4968058f + (4.0284505f + (-2.0811285f + (0.62884137f - 0.079153816f * m) * m) * m) * m);
+}
+
+// 10 * log10(power) = 10 * log10(2) * log2(power)
+static inline float power_to_db(float power)
+{
+  return 3.0103f * fast_log2f(power);
+}
 
 FFTAnalyzer::FFTAnalyzer(int length) :
+  FFTAnalyzer(length, -1, NULL, NULL, NULL)
+{
+}
+
+FFTAnalyzer::FFTAnalyzer(int length, int bitsPerSample, uint8_t* storage, const void* twiddles, const uint16_t* bitReverse) :
   _length(length),
+  _sampleRate(0),
   _bitsPerSample(-1),
   _channels(-1),
+  _hopSize(0),
+  _hopFrames(0),
+  _framePosition(0),
+  _window(FFT_WINDOW_NONE),
+  _output(FFT_OUTPUT_MAGNITUDE),
+  _averaging(FFT_AVERAGING_NONE),
+  _averagingFrames(1),
+  _averagedFrames(0),
+  _averageCount(0),
   _available(0),
   _sampleBuffer(NULL),
+  _sampleIndex(0),
   _fftBuffer(NULL),
-  _spectrumBuffer(NULL)
-{
-#ifdef ESP_PLATFORM
-  if (_data_buffer == NULL){
-    _data_buffer = (uint8_t*)malloc(_length);
-  }
+  _spectrumBuffer(NULL),
+  _windowBuffer(NULL),
+  _averageBuffer(NULL),
+  _spectrogramBuffer(NULL),
+  _spectrogramFrames(0),
+  _spectrogramSequence(0),
+  _spectrogramSlot(-1),
+  _peakBuffer(NULL),
+  _peakSlots(0),
+  _peakCount(0),
+  _zoomCenter(0.0f),
+  _zoomBandwidth(0.0f),
+  _zoomDecimation(1),
+  _zoomStageCount(0),
+  _zoomHistoryIndex(0),
+  _zoomBuffer(NULL),
+  _zoomHistory(NULL),
+  _zoomFFT(NULL),
+  _zoomWindow(NULL),
+  _zoomSpectrum(NULL),
+  _memoryUsage(0),
+  _storage(storage),
+  _storageUsed(0),
+  _storageBitsPerSample(bitsPerSample),
+  _storageWindow(NULL)
+#ifndef ESP_PLATFORM
+  , _inputBuffer(NULL),
+  _zoomInstance(NULL)
+#else
+  , _twiddleBuffer(NULL),
+  _data_buffer(NULL),
+  _storageTwiddles(twiddles),
+  _storageBitReverse(bitReverse),
+  _zoomTwiddles(NULL)
 #endif
+{
+  _zoomMixer[0] = 1.0f;
+  _zoomMixer[1] = 0.0f;
+  _zoomStep[0] = 1.0f;
+  _zoomStep[1] = 0.0f;
 }
 
 FFTAnalyzer::~FFTAnalyzer()
 {
-  if (_sampleBuffer) {
-    free(_sampleBuffer);
+  detach();
+  freeBuffers();
+}
+
+size_t FFTAnalyzer::memoryUsage()
+{
+  return _memoryUsage;
+}
+
+int FFTAnalyzer::setSpectrogram(int frames)
+{
+  if (frames < 0) {
+    return 0;
   }
 
-  if (_fftBuffer) {
-    free(_fftBuffer);
+  float* oldBuffer = _spectrogramBuffer;
+
+  // cleared first, frameComputed() may run from the I2S interrupt in between
+  _spectrogramBuffer = NULL;
+
+  if (oldBuffer) {
+    free(oldBuffer);
+    _memoryUsage -= _spectrogramFrames * binCount() * sizeof(float);
   }
 
-  if (_spectrumBuffer) {
-    free(_spectrumBuffer);
+  _spectrogramFrames = frames;
+
+  if (_bitsPerSample == -1) {
+    // not configured yet, the ring is allocated by configure()
+    return 1;
   }
 
-#ifdef ESP_PLATFORM
-  if (_data_buffer) {
-      free(_data_buffer);
+  return buildSpectrogram();
+}
+
+/*
+ * Spectrum sequence numbers run 1 .. 2^32 - 1 and then start over at 1, so 0 only means
+ * "before the first spectrum". A reader at 0 and one at 2^32 - 1 both wait for 1, so
+ * distances and steps are taken modulo 2^32 - 1 with 0 standing for 2^32 - 1.
+ */
+#define FRAME_SEQUENCE_PERIOD 0xffffffffULL
+
+// spectra from sequence from to sequence to
+static uint32_t frame_distance(uint32_t from, uint32_t to)
+{
+  uint64_t start = from ? from : FRAME_SEQUENCE_PERIOD;
+
+  return (uint32_t)((to + FRAME_SEQUENCE_PERIOD - start) % FRAME_SEQUENCE_PERIOD);
+}
+
+// sequence number steps spectra after from
+static uint32_t frame_advance(uint32_t from, uint32_t steps)
+{
+  uint64_t start = from ? from : FRAME_SEQUENCE_PERIOD;
+
+  return (uint32_t)((start - 1 + steps) % FRAME_SEQUENCE_PERIOD + 1);
+}
+
+uint32_t FFTAnalyzer::frameSequence()
+{
+  return _spectrogramSequence;
+}
+
+const float* FFTAnalyzer::frame(uint32_t sequence)
+{
+  #ifndef ESP_PLATFORM
+    // storeFrame() runs from the I2S interrupt, the sequence and the slot go together
+    noInterrupts();
+  #endif
+  uint32_t newest = _spectrogramSequence;
+  int slot = _spectrogramSlot;
+  #ifndef ESP_PLATFORM
+    interrupts();
+  #endif
+
+  return frameView(sequence, newest, slot);
+}
+
+const float* FFTAnalyzer::nextFrame(uint32_t* sequence, uint32_t* overwritten)
+{
+  #ifndef ESP_PLATFORM
+    // the missed count and the view come from the same newest spectrum
+    noInterrupts();
+  #endif
+  uint32_t newest = _spectrogramSequence;
+  int slot = _spectrogramSlot;
+  #ifndef ESP_PLATFORM
+    interrupts();
+  #endif
+
+  uint32_t pending = frame_distance(*sequence, newest);
+  uint32_t missed = 0;
+
+  if (_spectrogramBuffer == NULL || newest == 0 || pending == 0) {
+    if (overwritten) {
+      *overwritten = 0;
     }
-#endif
+
+    return NULL;
+  }
+
+  if (pending > (uint32_t)_spectrogramFrames) {
+    missed = pending - _spectrogramFrames;
+  }
+
+  *sequence = frame_advance(*sequence, missed + 1);
+  if (overwritten) {
+    *overwritten = missed;
+  }
+
+  return frameView(*sequence, newest, slot);
+}
+
+// view of spectrum sequence, given the newest sequence and its slot read together
+const float* FFTAnalyzer::frameView(uint32_t sequence, uint32_t newest, int slot)
+{
+  if (_spectrogramBuffer == NULL || sequence == 0 || newest == 0) {
+    return NULL;
+  }
+
+  uint32_t age = frame_distance(sequence, newest);
+
+  if (age >= (uint32_t)_spectrogramFrames) {
+    return NULL;
+  }
+
+  // counted back from the newest slot, a sequence modulo the ring size would jump at the wrap
+  slot -= (int)age;
+  if (slot < 0) {
+    slot += _spectrogramFrames;
+  }
+
+  return _spectrogramBuffer + slot * binCount();
+}
+
+int FFTAnalyzer::setPeaks(int count)
+{
+  if (count < 0) {
+    return 0;
+  }
+
+  FFTPeak* oldBuffer = _peakBuffer;
+
+  // cleared first, frameComputed() may run from the I2S interrupt in between
+  _peakBuffer = NULL;
+
+  if (oldBuffer) {
+    free(oldBuffer);
+    _memoryUsage -= _peakSlots * sizeof(FFTPeak);
+  }
+
+  _peakSlots = count;
+
+  if (_bitsPerSample == -1) {
+    // not configured yet, the peaks are allocated by configure()
+    return 1;
+  }
+
+  return buildPeaks();
+}
+
+int FFTAnalyzer::readPeaks(FFTPeak peaks[], int size)
+{
+  if (_peakBuffer == NULL) {
+    return 0;
+  }
+
+  if (size > _peakCount) {
+    size = _peakCount;
+  }
+
+  memcpy(peaks, _peakBuffer, sizeof(FFTPeak) * size);
+  _available = 0;
+
+  return size;
 }
 
 int FFTAnalyzer::available()
 {
   #ifdef ESP_PLATFORM
-    _input->read(_data_buffer, _length);
+    if (_attachedInput == NULL) {
+      return 0;
+    }
+
+    if (_data_buffer) {
+      _attachedInput->read(_data_buffer, _length);
+    }
   #endif
 
   return _available;
 }
 
 int FFTAnalyzer::readFloat(float spectrum[], int size){
-  memcpy(spectrum, _spectrumBuffer, sizeof(float) * size);
+  if (_spectrumBuffer == NULL && _zoomBuffer == NULL) {
+    return 0;
+  }
+
+  if (size > binCount()) {
+    // DC .. Nyquist, or the zoomed band
+    size = binCount();
+  }
+
+  const float* bins = floatSpectrum();
+
+  if (bins) {
+    memcpy(spectrum, bins, sizeof(float) * size);
+  } else {
+    for (int i = 0; i < size; i++) {
+      spectrum[i] = spectrumValue(i);
+    }
+  }
   _available = 0;
   return size;
 }
@@ -76,8 +336,31 @@ int FFTAnalyzer::read(int spectrum[], int size)
     return 0;
   }
 
-  if (size > (_length / 2)) {
-    size = _length / 2;
+  if (size > binCount()) {
+    // DC .. Nyquist, or the zoomed band
+    size = binCount();
+  }
+
+  if (_output == FFT_OUTPUT_DB) {
+    // decibels can be negative, round instead of the unsigned conversion below
+    for (int i = 0; i < size; i++) {
+      spectrum[i] = (int)lroundf(spectrumValue(i));
+    }
+
+    _available = 0;
+
+    return size;
+  }
+
+  if (_averageBuffer || _zoomBuffer) {
+    // convert from float to int even if that means often overflowing the int
+    for (int i = 0; i < size; i++) {
+      spectrum[i] = (long unsigned int)spectrumValue(i);
+    }
+
+    _available = 0;
+
+    return size;
   }
 
   if (_bitsPerSample == 16) {
@@ -110,11 +393,102 @@ int FFTAnalyzer::read(int spectrum[], int size)
   return size;
 }
 
-int FFTAnalyzer::configure(AudioIn* input){
+// spectrum bin as float, fixed point bins are converted to decibels here when that output is selected
+float FFTAnalyzer::spectrumValue(int bin)
+{
+  const float* bins = floatSpectrum();
+
+  if (bins) {
+    return bins[bin];
+  }
+
+  #ifdef ESP_PLATFORM
+    return ((float*)_spectrumBuffer)[bin];
+  #else
+    float value = transformValue(bin);
+
+    if (_output == FFT_OUTPUT_DB) {
+      value = power_to_db(value);
+    }
+
+    return value;
+  #endif
+}
+
+void FFTAnalyzer::spectrumComputed()
+{
+}
+
+uint32_t FFTAnalyzer::framePosition()
+{
+  return _framePosition;
+}
+
+long FFTAnalyzer::sampleRate()
+{
+  return _sampleRate;
+}
+
+bool FFTAnalyzer::zoomed()
+{
+  return _zoomBandwidth > 0.0f;
+}
+
+// bin as written by the last transform, before averaging
+float FFTAnalyzer::transformValue(int bin)
+{
+  if (_zoomBuffer) {
+    return _zoomSpectrum[bin];
+  }
+
+  #ifdef ESP_PLATFORM
+    return ((float*)_spectrumBuffer)[bin];
+  #else
+    if (_bitsPerSample == 16) {
+      return ((q15_t*)_spectrumBuffer)[bin];
+    }
+
+    return ((q31_t*)_spectrumBuffer)[bin];
+  #endif
+}
+
+// the reported bins when they are floats in the output format already, else NULL
+const float* FFTAnalyzer::floatSpectrum()
+{
+  if (_averageBuffer) {
+    return _averageBuffer + binCount();
+  }
+
+  if (_zoomBuffer) {
+    return _zoomSpectrum;
+  }
+
   #ifdef ESP_PLATFORM
-  _input = input;
+    return (const float*)_spectrumBuffer;
+  #else
+    return NULL;
   #endif
+}
+
+// DC .. Nyquist of the real transform, all bins of the complex zoom transform
+int FFTAnalyzer::binCount()
+{
+  return _zoomBuffer ? _length : _length / 2 + 1;
+}
+
+float FFTAnalyzer::binFrequency(float bin)
+{
+  if (_zoomBuffer) {
+    // the zoomed bins run from centre - rate / 2 to centre + rate / 2 of the decimated rate
+    return _zoomCenter + (bin - _length / 2) * _sampleRate / ((float)_zoomDecimation * _length);
+  }
+
+  return bin * _sampleRate / _length;
+}
+
+int FFTAnalyzer::configure(AudioIn* input){
   _channels = input->channels();
+  _sampleRate = input->sampleRate();
 
   int bitsPerSample = input->bitsPerSample();
 
@@ -126,199 +500,1292 @@ int FFTAnalyzer::configure(AudioIn* input){
     return 0;
   }
 
-  if (bitsPerSample == 16) {
-    #ifdef ESP_PLATFORM
-      // FFT using 16-bit fixed point
-      if (ESP_OK != dsps_fft2r_init_sc16(NULL, _length)) {
-    #else
+  #ifdef ESP_PLATFORM
+    // radix-2 half size FFT, the twiddle table is generated below
+    if (_length < 8 || (_length & (_length - 1))) {
+      return 0;
+    }
+  #else
+    if (bitsPerSample == 16) {
       if (ARM_MATH_SUCCESS != arm_rfft_init_q15(&_S15, _length, 0, 1)) {
-    #endif
         return 0;
       }
-  } else {
-    #ifdef ESP_PLATFORM
-      // FFT using 32-bit floating point
-      if (ESP_OK != dsps_fft2r_init_fc32(NULL, _length)) {
-    #else
+    } else {
       //  (struct , length of the FFT, 1=forward transform, 0=enable bit reversal of output)
       if (ARM_MATH_SUCCESS != arm_rfft_init_q31(&_S31, _length, 0, 1)) {
-    #endif
         return 0;
       }
+    }
+  #endif
+
+  if (_storage && bitsPerSample != _storageBitsPerSample) {
+    // the storage and tables of StaticFFTAnalyzer are sized for one sample format
+    return 0;
   }
 
   _bitsPerSample = bitsPerSample;
 
-  if (bitsPerSample == 16) {
-  #ifdef ESP_PLATFORM
-      _sampleBufferSize = _length * sizeof(int16_t);
-      _sampleBuffer = calloc(_sampleBufferSize, 1);
-      _spectrumBuffer = calloc(_length, sizeof(int16_t));
-    } else {
-      _sampleBufferSize = _length * sizeof(uint32_t);
-      _sampleBuffer = calloc(_sampleBufferSize, 1);
-      _spectrumBuffer = calloc(_length, sizeof(uint32_t));
-  #else
-      _sampleBufferSize = _length * sizeof(q15_t);
-      _sampleBuffer = calloc(_sampleBufferSize, 1);
-      _spectrumBuffer = calloc(_length, sizeof(q15_t));
-    } else {
-      _sampleBufferSize = _length * sizeof(q31_t);
-      _sampleBuffer = calloc(_sampleBufferSize, 1);
-      _spectrumBuffer = calloc(_length, sizeof(q31_t));
-  #endif
-  }
+  // every buffer used by update() is allocated here once, so the audio path
+  // never touches the heap and can not drop a frame on allocation failure
+  freeBuffers();
 
-  _fftBuffer = calloc(_sampleBufferSize * 2, 1);
+  _sampleIndex = 0;
+  _framePosition = 0;
+  #ifdef ESP_PLATFORM
+    _data_buffer = (uint8_t*)allocate(_length);
 
-  if (_sampleBuffer == NULL || _fftBuffer == NULL || _spectrumBuffer == NULL) {
-    if (_sampleBuffer) {
-      free(_sampleBuffer);
-      _sampleBuffer = NULL;
+    if (_data_buffer == NULL) {
+      return 0;
     }
 
-    if (_fftBuffer) {
-      free(_fftBuffer);
-      _fftBuffer = NULL;
-    }
+    _memoryUsage = _length;
+  #endif
 
-    if (_spectrumBuffer) {
-      free(_spectrumBuffer);
-      _spectrumBuffer = NULL;
-    }
+  // the zoom sets the number of bins the other buffers are sized for
+  if (!buildTransform() || !buildWindow() || !buildZoom() || !buildAveraging() || !buildSpectrogram() || !buildPeaks()) {
+    freeBuffers();
 
     return 0;
   }
+
   return 1;
 }
 
-/*
- * 1. Recompute sample size - we only take number of samples disregarding number of channels
- * 2. Shift samples from high addresses to low addresses while dropping old samples on low addresses
- * 3. Make new pointer into sample buffer pointing to start of new samples
- * 4. Based on number of channels (1 or 2) and bits per second (16 or 32) move new samples to sample buffer
- * 5. Based on number of samples (16 or 32) compute Real Fast Fourier Transform followed by Complex Magnitude
- * 6. Set up _available = 1
- */
-void FFTAnalyzer::update(const void* buffer, size_t size)
+void* FFTAnalyzer::allocate(int size)
 {
-  int newSamplesSize = (size / _channels);
-
-  if (newSamplesSize > _sampleBufferSize) {
-    // more samples than buffer size, cap
-    newSamplesSize = _sampleBufferSize;
+  if (_storage == NULL) {
+    return calloc(size, 1);
   }
 
-  int newSamplesOffset = _sampleBufferSize - newSamplesSize;
-  if (newSamplesOffset) {
-    // shift over the previous samples
-    memmove(_sampleBuffer, ((uint8_t*)_sampleBuffer) + newSamplesSize, newSamplesOffset);
-  }
+  // compile time sized variant, the buffer is carved out of its storage
+  uint8_t* buffer = _storage + _storageUsed;
 
-  uint8_t* newSamples = ((uint8_t*)_sampleBuffer) + newSamplesOffset;
-  int samples = size / (_bitsPerSample / 8);
+  _storageUsed += (size + 3) & ~3;
+  memset(buffer, 0, size);
 
-  if (_channels == 2) {
-    // average the stereo samples to mono
-    if (_bitsPerSample == 16) {
-      const int16_t *src = (const int16_t*)buffer;
-      int16_t* dst = (int16_t*)newSamples;
+  return buffer;
+}
 
-      for (int i = 0; i < samples; i += 2) {
+void FFTAnalyzer::freeBuffers()
+{
+  // the averaging, spectrogram, peak and zoom buffers are never part of the StaticFFTAnalyzer storage
+  if (_averageBuffer) {
+    free(_averageBuffer);
+    _averageBuffer = NULL;
+  }
 
-        *dst = (*src++) / 2;
+  if (_spectrogramBuffer) {
+    free(_spectrogramBuffer);
+    _spectrogramBuffer = NULL;
+  }
 
-        *dst += (*src++) / 2;
+  if (_peakBuffer) {
+    free(_peakBuffer);
+    _peakBuffer = NULL;
+  }
 
-        dst++;
-      }
-    } else { // 32 bit
-      const int32_t *src = (const int32_t*)buffer;
-      int32_t* dst = (int32_t*)newSamples;
+  if (_zoomBuffer) {
+    free(_zoomBuffer);
+    _zoomBuffer = NULL;
+  }
 
-      for (int i = 0; i < samples; i += 2) {
-        *dst = *src / 2;
+  if (_storage) {
+    // nothing to free, the buffers are part of the StaticFFTAnalyzer object
+    _sampleBuffer = NULL;
+    _fftBuffer = NULL;
+    _spectrumBuffer = NULL;
+    _windowBuffer = NULL;
+    _storageWindow = NULL;
+    #ifndef ESP_PLATFORM
+      _inputBuffer = NULL;
+    #else
+      _twiddleBuffer = NULL;
+      _data_buffer = NULL;
+    #endif
+    _storageUsed = 0;
+    _memoryUsage = 0;
 
-        src++;
-        *dst += *src / 2;
+    return;
+  }
 
-        src++;
+  if (_sampleBuffer) {
+    free(_sampleBuffer);
+    _sampleBuffer = NULL;
+  }
 
-        dst++;
-      }
-    }
-  } else {
-      memcpy(newSamples, buffer, size);
+  if (_fftBuffer) {
+    free(_fftBuffer);
+    _fftBuffer = NULL;
   }
-  #ifdef ESP_PLATFORM
-    if (_bitsPerSample == 16){
-      int16_t *real_buffer;
-      real_buffer = (int16_t*)calloc(_length*2,sizeof(int16_t));
-      if(real_buffer == NULL){
-        return; // unfortunatelly original method is void
-      }
-      real_int16_to_complex_int16((int16_t*)_sampleBuffer, _length, real_buffer);
-      #if defined ESP32
-        dsps_fft2r_sc16_ae32(real_buffer, _length); // FFT using 16-bit fixed point optimized for ESP32
-      #elif defined ESP32S2
-        dsps_fft2r_sc16_ansi(real_buffer, _length); // FFT using 16-bit fixed point
-      #endif
-      dsps_bit_rev_sc16_ansi(real_buffer, _length);
-      int16_cmplx_mag(real_buffer, (float*)_spectrumBuffer, _length);
-      free(real_buffer);
-    } else { // assuming 32 bit input
-      float *real_buffer;
-      real_buffer = (float*)calloc(_length*2,sizeof(float));
-      if(real_buffer == NULL){
-        return; // unfortunatelly original method is void
-      }
 
-      real_uint32_to_complex_float((uint32_t*)_sampleBuffer, _length, real_buffer);
-      #if defined ESP32
-        dsps_fft2r_fc32_ae32(real_buffer, _length); // FFT using 32-bit floating point optimized for ESP32
-      #elif defined ESP32S2
-        dsps_fft2r_fc32_ansi(real_buffer, _length); // FFT using 32-bit floating point
-      #endif
-      dsps_bit_rev_fc32_ansi(real_buffer, _length);
+  if (_spectrumBuffer) {
+    free(_spectrumBuffer);
+    _spectrumBuffer = NULL;
+  }
 
-      float_cmplx_mag(real_buffer, (float*)_spectrumBuffer, _length);
-      free(real_buffer);
-    }
-  #else
-    if (_bitsPerSample == 16) {
-      arm_rfft_q15(&_S15, (q15_t*)_sampleBuffer, (q15_t*)_fftBuffer);
+  if (_windowBuffer) {
+    free(_windowBuffer);
+    _windowBuffer = NULL;
+  }
 
-      arm_cmplx_mag_q15((q15_t*)_fftBuffer, (q15_t*)_spectrumBuffer, _length);
-    } else {
-      //           struct   input( is modified)             output
-      arm_rfft_q31(&_S31, (q31_t*)_sampleBuffer, (q31_t*)_fftBuffer);
+#ifndef ESP_PLATFORM
+  if (_inputBuffer) {
+    free(_inputBuffer);
+    _inputBuffer = NULL;
+  }
+#else
+  if (_twiddleBuffer) {
+    free(_twiddleBuffer);
+    _twiddleBuffer = NULL;
+  }
 
-      // _spectrumBuffer[n] = sqrt(_fftBuffer[(2*n)+0]^2 + _fftBuffer[(2*n)+1]^2);
-      arm_cmplx_mag_q31((q31_t*)_fftBuffer, (q31_t*) _spectrumBuffer, _length);
-    }
-  #endif // #ifdef ESP_PLATFORM
-  _available = 1;
-}
+  if (_data_buffer) {
+    free(_data_buffer);
+    _data_buffer = NULL;
+  }
+#endif
 
-// convert uint32_t array with real members to complex array with zero Im
-// from input[0]=Re[0], input[1]=Re[1], ...
-// to output[0]=Re[0], output[1]=Im[0]=0.0, output[2]=Re[1], output[3]=Im[1]=0.0, ...
-// length of output is input_length*2
-void FFTAnalyzer::real_uint32_to_complex_float(uint32_t* input, int length, float* output){
-  for(int i = 0 ; i < length; ++i){
-    output[i*2] = (float)input[i]; // Re
-    //output[i*2+1] = 0.0; // Im=0
+  _memoryUsage = 0;
+}
+
+void FFTAnalyzer::setHopSize(int hopSize)
+{
+  if (hopSize < 0) {
+    hopSize = 0;
+  }
+
+  _hopSize = hopSize;
+  _hopFrames = 0;
+}
+
+void FFTAnalyzer::setOverlap(int percent)
+{
+  if (percent < 0) {
+    percent = 0;
+  } else if (percent > 99) {
+    percent = 99;
+  }
+
+  int hopSize = (_length * (100 - percent)) / 100;
+
+  setHopSize(hopSize > 0 ? hopSize : 1);
+}
+
+void FFTAnalyzer::setOutput(FFTOutput output)
+{
+  _output = output;
+}
+
+int FFTAnalyzer::setAveraging(FFTAveraging averaging, int frames)
+{
+  if (frames < 1) {
+    return 0;
+  }
+
+  _averaging = averaging;
+  _averagingFrames = frames;
+
+  if (_bitsPerSample == -1) {
+    // not configured yet, the buffer is allocated by configure()
+    return 1;
+  }
+
+  return buildAveraging();
+}
+
+int FFTAnalyzer::setWindow(FFTWindow window)
+{
+  if (window < FFT_WINDOW_NONE || window > FFT_WINDOW_FLAT_TOP) {
+    // indexes windowTerms
+    return 0;
+  }
+
+  _window = window;
+
+  if (_bitsPerSample == -1) {
+    // not configured yet, the table is built by configure()
+    return 1;
+  }
+
+  if (_zoomBuffer) {
+    buildZoomWindow();
+
+    return 1;
+  }
+
+  return buildWindow();
+}
+
+int FFTAnalyzer::setZoom(float centerFrequency, float bandwidth)
+{
+  if (_bitsPerSample != -1 || bandwidth < 0.0f || centerFrequency < 0.0f) {
+    // the zoom buffers and the number of bins are fixed by configure()
+    return 0;
+  }
+
+  _zoomCenter = centerFrequency;
+  _zoomBandwidth = bandwidth;
+
+  return 1;
+}
+
+/*
+ * Cosine sum windows, w[n] = a0 - a1*cos(2*pi*n/N) + a2*cos(4*pi*n/N) - ...
+ * Periodic (DFT-even) form, which is the one to use before an FFT.
+ */
+static const float windowTerms[][5] = {
+  { 1.0f,        0.0f,        0.0f,         0.0f,         0.0f        }, // FFT_WINDOW_NONE
+  { 0.5f,        0.5f,        0.0f,         0.0f,         0.0f        }, // FFT_WINDOW_HANN
+  { 0.54f,       0.46f,       0.0f,         0.0f,         0.0f        }, // FFT_WINDOW_HAMMING
+  { 0.35875f,    0.48829f,    0.14128f,     0.01168f,     0.0f        }, // FFT_WINDOW_BLACKMAN_HARRIS
+  { 0.21557895f, 0.41663158f, 0.277263158f, 0.083578947f, 0.006947368f }  // FFT_WINDOW_FLAT_TOP
+};
+
+static float window_coefficient(FFTWindow window, int n, int length)
+{
+  const float* terms = windowTerms[window];
+  float w = 0.0f;
+
+  for (int k = 0; k < 5; k++) {
+    float term = terms[k] * cosf(2.0f * (float)M_PI * k * n / length);
+
+    w += (k & 1) ? -term : term;
+  }
+
+  if (w > 1.0f) {
+    // rounding must not overflow the fixed point formats
+    w = 1.0f;
   }
+
+  return w;
 }
 
-// convert uint16_t array with real members to complex array with zero Im
-// from input[0]=Re[0], input[1]=Re[1], ...
-// to output[0]=Re[0], output[1]=Im[0]=0.0, output[2]=Re[1], output[3]=Im[1]=0.0, ...
-// length of output is input_length*2
-void FFTAnalyzer::real_int16_to_complex_int16(int16_t* input, int length, int16_t* output){
+// history, FFT work area and spectrum of the real transform, the zoom has its own
+int FFTAnalyzer::buildTransform()
+{
+  if (_zoomBandwidth > 0.0f) {
+    // zoomUpdate() never reads them
+    return 1;
+  }
+
+  int sampleSize = (_bitsPerSample == 16) ? sizeof(int16_t) : sizeof(int32_t);
+  #ifdef ESP_PLATFORM
+    // _length / 2 complex points for the half size FFT, its twiddle table
+    // followed by the _length / 4 + 1 twiddles of the real split step
+    int fftSize = _length * sampleSize;
+    int twiddleSize = (_length + 2) * sampleSize;
+    int spectrumSize = (_length / 2 + 1) * sizeof(float);
+  #else
+    // arm_rfft_* writes _length complex values
+    int fftSize = _length * 2 * sampleSize;
+    int spectrumSize = (_length / 2 + 1) * sampleSize;
+  #endif
+
+  _sampleBufferSize = _length * sampleSize;
+  _sampleBuffer = allocate(_sampleBufferSize);
+  #ifndef ESP_PLATFORM
+    _inputBuffer = allocate(_sampleBufferSize);
+  #endif
+  _fftBuffer = allocate(fftSize);
+  _spectrumBuffer = allocate(spectrumSize);
+  #ifdef ESP_PLATFORM
+    _twiddleBuffer = _storage ? (void*)_storageTwiddles : allocate(twiddleSize);
+  #endif
+  if (_storage) {
+    // the window has a fixed slot, see storageSize()
+    _storageWindow = allocate(_sampleBufferSize);
+  }
+
+  if (_sampleBuffer == NULL || _fftBuffer == NULL || _spectrumBuffer == NULL
+  #ifdef ESP_PLATFORM
+      || _twiddleBuffer == NULL
+  #else
+      || _inputBuffer == NULL
+  #endif
+  ) {
+    return 0;
+  }
+
+  _memoryUsage += _sampleBufferSize + fftSize + spectrumSize;
+  #ifndef ESP_PLATFORM
+    _memoryUsage += _sampleBufferSize;
+  #endif
+
+  #ifdef ESP_PLATFORM
+    if (_storage == NULL) {
+      _memoryUsage += twiddleSize;
+
+      // private twiddle table, so analyzers of different lengths can coexist
+      int halfLength = _length / 2;
+
+      if (_bitsPerSample == 16) {
+        int16_t* twiddles = (int16_t*)_twiddleBuffer;
+
+        dsps_gen_w_r2_sc16(twiddles, halfLength);
+        dsps_bit_rev_sc16_ansi(twiddles, halfLength >> 1);
+        fft_split_twiddles_int16(twiddles + halfLength, _length);
+      } else {
+        float* twiddles = (float*)_twiddleBuffer;
+
+        dsps_gen_w_r2_fc32(twiddles, halfLength);
+        dsps_bit_rev_fc32_ansi(twiddles, halfLength >> 1);
+        fft_split_twiddles_float(twiddles + halfLength, _length);
+      }
+    }
+  #endif
+
+  return 1;
+}
+
+// compute the window coefficients once, in the format the FFT input uses
+int FFTAnalyzer::buildWindow()
+{
+  void* windowBuffer = NULL;
+
+  if (_zoomBandwidth > 0.0f) {
+    // the zoom window is built by buildZoomWindow()
+    return 1;
+  }
+
+  if (_window != FFT_WINDOW_NONE) {
+    windowBuffer = _storage ? _storageWindow : malloc(_sampleBufferSize);
+
+    if (windowBuffer == NULL) {
+      return 0;
+    }
+
+    for (int n = 0; n < _length; n++) {
+      float w = window_coefficient(_window, n, _length);
+
+      if (_bitsPerSample == 16) {
+        ((int16_t*)windowBuffer)[n] = (int16_t)lroundf(w * 32767.0f);
+      } else {
+        #ifdef ESP_PLATFORM
+          ((float*)windowBuffer)[n] = w;
+        #else
+          ((q31_t*)windowBuffer)[n] = (q31_t)lround(w * 2147483647.0);
+        #endif
+      }
+    }
+  }
+
+  void* oldBuffer = _windowBuffer;
+
+  _windowBuffer = windowBuffer;
+
+  if (oldBuffer) {
+    if (oldBuffer != _storageWindow) {
+      free(oldBuffer);
+    }
+    _memoryUsage -= _sampleBufferSize;
+  }
+
+  if (windowBuffer) {
+    _memoryUsage += _sampleBufferSize;
+  }
+
+  return 1;
+}
+
+// running average and result spectrum, both binCount() floats, restarts the average
+int FFTAnalyzer::buildAveraging()
+{
+  int bins = binCount();
+  int averageSize = 2 * bins * sizeof(float);
+
+  _averagedFrames = 0;
+  _averageCount = 0;
+
+  if (_averaging == FFT_AVERAGING_NONE) {
+    float* oldBuffer = _averageBuffer;
+
+    // cleared first, frameComputed() may run from the I2S interrupt in between
+    _averageBuffer = NULL;
+
+    if (oldBuffer) {
+      free(oldBuffer);
+      _memoryUsage -= averageSize;
+    }
+
+    return 1;
+  }
+
+  if (_averageBuffer == NULL) {
+    _averageBuffer = (float*)calloc(2 * bins, sizeof(float));
+
+    if (_averageBuffer == NULL) {
+      return 0;
+    }
+
+    _memoryUsage += averageSize;
+  }
+
+  return 1;
+}
+
+// ring of _spectrogramFrames spectra, restarts the sequence numbers
+int FFTAnalyzer::buildSpectrogram()
+{
+  _spectrogramSequence = 0;
+  _spectrogramSlot = _spectrogramFrames - 1;
+
+  if (_spectrogramFrames == 0 || _spectrogramBuffer) {
+    return 1;
+  }
+
+  int spectrogramSize = _spectrogramFrames * binCount() * sizeof(float);
+
+  _spectrogramBuffer = (float*)malloc(spectrogramSize);
+
+  if (_spectrogramBuffer == NULL) {
+    return 0;
+  }
+
+  _memoryUsage += spectrogramSize;
+
+  return 1;
+}
+
+// splits decimation into at most FFT_ZOOM_MAX_STAGES factors of at most 16, largest first,
+// returns the number of factors or -1
+static int zoom_factors(int decimation, int* factors)
+{
+  int count = 0;
+
+  while (decimation > 1) {
+    int factor = 16;
+
+    while (decimation % factor) {
+      factor--;
+    }
+
+    if (factor == 1 || count == FFT_ZOOM_MAX_STAGES) {
+      return -1;
+    }
+
+    factors[count++] = factor;
+    decimation /= factor;
+  }
+
+  return count;
+}
+
+/*
+ * Zoom buffers, all carved out of one allocation:
+ *   per stage the low-pass taps and the doubled complex delay line, then the complex
+ *   history, FFT work area, window, spectrum and on ESP32 the twiddles of the _length
+ *   point complex FFT
+ * The decimation is split into stages of at most 16, so the taps grow with the sum of
+ * the stage factors instead of their product: 100 Hz of a 48 kHz input decimates by
+ * 16 x 15 x 2 with 528 taps instead of 7680. Every stage is a Hamming windowed sinc with
+ * 16 taps per decimation phase and its cutoff at its output Nyquist frequency. Aliases
+ * from the transition bands of the earlier stages land outside the final band, the last
+ * one leaves about the outer 10% of the band on each side in its transition band.
+ */
+int FFTAnalyzer::buildZoom()
+{
+  if (_zoomBandwidth <= 0.0f) {
+    return 1;
+  }
+
+  if (_sampleRate <= 0 || _zoomCenter > _sampleRate / 2.0f) {
+    return 0;
+  }
+
+  #ifndef ESP_PLATFORM
+    switch (_length) {
+      case 16: _zoomInstance = &arm_cfft_sR_f32_len16; break;
+      case 32: _zoomInstance = &arm_cfft_sR_f32_len32; break;
+      case 64: _zoomInstance = &arm_cfft_sR_f32_len64; break;
+      case 128: _zoomInstance = &arm_cfft_sR_f32_len128; break;
+      case 256: _zoomInstance = &arm_cfft_sR_f32_len256; break;
+      case 512: _zoomInstance = &arm_cfft_sR_f32_len512; break;
+      case 1024: _zoomInstance = &arm_cfft_sR_f32_len1024; break;
+      case 2048: _zoomInstance = &arm_cfft_sR_f32_len2048; break;
+      case 4096: _zoomInstance = &arm_cfft_sR_f32_len4096; break;
+      default: return 0;
+    }
+  #endif
+
+  float span = _sampleRate / _zoomBandwidth;
+  int decimation = (span < 65536.0f) ? (int)span : 65536;
+  int factors[FFT_ZOOM_MAX_STAGES];
+  int stages;
+
+  if (decimation < 1) {
+    decimation = 1;
+  }
+
+  // a prime factor above 16 would need a long single stage, a lower decimation widens the band a little
+  while ((stages = zoom_factors(decimation, factors)) < 0) {
+    decimation--;
+  }
+
+  int stageTaps = 0;
+
+  for (int i = 0; i < stages; i++) {
+    stageTaps += 16 * factors[i];
+  }
+
+  int zoomSize = (5 * stageTaps + 2 * _length + 2 * _length + _length + _length) * sizeof(float);
+  #ifdef ESP_PLATFORM
+    zoomSize += _length * sizeof(float);
+  #endif
+
+  _zoomBuffer = (float*)calloc(zoomSize, 1);
+
+  if (_zoomBuffer == NULL) {
+    return 0;
+  }
+
+  float* next = _zoomBuffer;
+
+  for (int i = 0; i < stages; i++) {
+    ZoomStage* stage = &_zoomStages[i];
+
+    stage->decimation = factors[i];
+    stage->taps = 16 * factors[i];
+    stage->phase = 0;
+    stage->delayIndex = 0;
+    stage->coefficients = next;
+    stage->delay = stage->coefficients + stage->taps;
+    next = stage->delay + 4 * stage->taps;
+
+    zoomLowPass(stage->coefficients, stage->taps, stage->decimation);
+  }
+
+  _zoomHistory = next;
+  _zoomFFT = _zoomHistory + 2 * _length;
+  _zoomWindow = _zoomFFT + 2 * _length;
+  _zoomSpectrum = _zoomWindow + _length;
+  #ifdef ESP_PLATFORM
+    _zoomTwiddles = _zoomSpectrum + _length;
+
+    dsps_gen_w_r2_fc32(_zoomTwiddles, _length);
+    dsps_bit_rev_fc32_ansi(_zoomTwiddles, _length >> 1);
+  #endif
+
+  buildZoomWindow();
+
+  float w = 2.0f * (float)M_PI * _zoomCenter / _sampleRate;
+
+  _zoomDecimation = decimation;
+  _zoomStageCount = stages;
+  _zoomHistoryIndex = 0;
+  _zoomMixer[0] = 1.0f;
+  _zoomMixer[1] = 0.0f;
+  _zoomStep[0] = cosf(w);
+  _zoomStep[1] = -sinf(w);
+  _memoryUsage += zoomSize;
+
+  return 1;
+}
+
+// Hamming windowed sinc with its cutoff at the Nyquist frequency after decimation
+void FFTAnalyzer::zoomLowPass(float* coefficients, int taps, int decimation)
+{
+  float cutoff = 0.5f / decimation;
+  float middle = 0.5f * (taps - 1);
+  float sum = 0.0f;
+
+  for (int k = 0; k < taps; k++) {
+    float t = k - middle;
+    float sinc = (t == 0.0f) ? 2.0f * cutoff : sinf(2.0f * (float)M_PI * cutoff * t) / ((float)M_PI * t);
+    float hamming = 0.54f - 0.46f * cosf(2.0f * (float)M_PI * k / (taps - 1));
+
+    coefficients[k] = sinc * hamming;
+    sum += coefficients[k];
+  }
+
+  for (int k = 0; k < taps; k++) {
+    // unity gain at 0 Hz
+    coefficients[k] /= sum;
+  }
+}
+
+// the window of the zoom transform is applied to complex float samples
+void FFTAnalyzer::buildZoomWindow()
+{
+  for (int n = 0; n < _length; n++) {
+    _zoomWindow[n] = window_coefficient(_window, n, _length);
+  }
+}
+
+/*
+ * 1. Mix every input frame down by the zoom centre: z = x * e^(-j*w*n), the mixer phasor is
+ *    renormalized at every decimated sample so its rounding errors do not build up
+ * 2. Run z through the decimator stages, see zoomDecimate()
+ * 3. Append their output to the complex history, and transform every hop of decimated samples
+ */
+void FFTAnalyzer::zoomUpdate(const uint8_t* buffer, int frames)
+{
+  int hopSize = (_hopSize > 0) ? _hopSize : _length;
+
+  for (int i = 0; i < frames; i++) {
+    float x;
+
+    if (_bitsPerSample == 16) {
+      const int16_t* src = (const int16_t*)buffer + i * _channels;
+
+      x = (_channels == 2) ? 0.5f * ((float)src[0] + (float)src[1]) : (float)src[0];
+    } else {
+      const int32_t* src = (const int32_t*)buffer + i * _channels;
+
+      x = (_channels == 2) ? 0.5f * ((float)src[0] + (float)src[1]) : (float)src[0];
+    }
+
+    float mixerReal = _zoomMixer[0];
+    float mixerImag = _zoomMixer[1];
+    float real = x * mixerReal;
+    float imag = x * mixerImag;
+
+    _zoomMixer[0] = mixerReal * _zoomStep[0] - mixerImag * _zoomStep[1];
+    _zoomMixer[1] = mixerReal * _zoomStep[1] + mixerImag * _zoomStep[0];
+
+    _framePosition++;
+
+    if (!zoomDecimate(&real, &imag)) {
+      continue;
+    }
+
+    _zoomHistory[2 * _zoomHistoryIndex] = real;
+    _zoomHistory[2 * _zoomHistoryIndex + 1] = imag;
+
+    if (++_zoomHistoryIndex == _length) {
+      _zoomHistoryIndex = 0;
+    }
+
+    float magnitude = _zoomMixer[0] * _zoomMixer[0] + _zoomMixer[1] * _zoomMixer[1];
+    float correction = 1.5f - 0.5f * magnitude;
+
+    _zoomMixer[0] *= correction;
+    _zoomMixer[1] *= correction;
+
+    if (++_hopFrames >= hopSize) {
+      _hopFrames = 0;
+      zoomTransform();
+      frameComputed();
+    }
+  }
+}
+
+/*
+ * Pushes a complex sample into the first stage; a stage computes one filtered sample every
+ * decimation inputs, the only one it keeps (the polyphase form of the filter), and pushes it
+ * into the next one. Returns 1 with the output of the last stage in *real, *imag.
+ */
+int FFTAnalyzer::zoomDecimate(float* real, float* imag)
+{
+  for (int i = 0; i < _zoomStageCount; i++) {
+    ZoomStage* stage = &_zoomStages[i];
+    int taps = stage->taps;
+    float* slot = stage->delay + 2 * stage->delayIndex;
+
+    slot[0] = slot[2 * taps] = *real;
+    slot[1] = slot[2 * taps + 1] = *imag;
+
+    if (++stage->delayIndex == taps) {
+      stage->delayIndex = 0;
+    }
+
+    if (++stage->phase < stage->decimation) {
+      return 0;
+    }
+
+    stage->phase = 0;
+
+    // the taps are symmetric, so the oldest sample meets the first one
+    const float* delay = stage->delay + 2 * stage->delayIndex;
+    float sumReal = 0.0f;
+    float sumImag = 0.0f;
+
+    for (int k = 0; k < taps; k++) {
+      sumReal += stage->coefficients[k] * delay[2 * k];
+      sumImag += stage->coefficients[k] * delay[2 * k + 1];
+    }
+
+    *real = sumReal;
+    *imag = sumImag;
+  }
+
+  return 1;
+}
+
+// windowed complex FFT of the decimated history, bins reordered from the lowest frequency up
+void FFTAnalyzer::zoomTransform()
+{
+  int halfLength = _length / 2;
+
+  for (int n = 0; n < _length; n++) {
+    int index = _zoomHistoryIndex + n;
+
+    if (index >= _length) {
+      index -= _length;
+    }
+
+    _zoomFFT[2 * n] = _zoomHistory[2 * index] * _zoomWindow[n];
+    _zoomFFT[2 * n + 1] = _zoomHistory[2 * index + 1] * _zoomWindow[n];
+  }
+
+  #ifdef ESP_PLATFORM
+    #if defined ESP32
+      dsps_fft2r_fc32_ae32_(_zoomFFT, _length, _zoomTwiddles);
+    #elif defined ESP32S2
+      dsps_fft2r_fc32_ansi_(_zoomFFT, _length, _zoomTwiddles);
+    #endif
+    dsps_bit_rev_fc32_ansi(_zoomFFT, _length);
+  #else
+    arm_cfft_f32(_zoomInstance, _zoomFFT, 0, 1);
+  #endif
+
+  // negative frequencies first
+  magnitude_float(_zoomFFT + _length, _zoomSpectrum, halfLength);
+  magnitude_float(_zoomFFT, _zoomSpectrum + halfLength, halfLength);
+}
+
+int FFTAnalyzer::buildPeaks()
+{
+  _peakCount = 0;
+
+  if (_peakSlots == 0 || _peakBuffer) {
+    return 1;
+  }
+
+  _peakBuffer = (FFTPeak*)malloc(_peakSlots * sizeof(FFTPeak));
+
+  if (_peakBuffer == NULL) {
+    return 0;
+  }
+
+  _memoryUsage += _peakSlots * sizeof(FFTPeak);
+
+  return 1;
+}
+
+/*
+ * 1. Recompute sample size - we only take number of frames disregarding number of channels
+ * 2. Without a hop size: keep only the newest _length frames of the block, write them into
+ *    the circular sample history and transform once per block
+ * 3. With a hop size: split the block at hop boundaries, frames that can not reach the
+ *    next transform are skipped, and transform every time a full hop has been written
+ * 4. Count the computed spectra in _available
+ */
+void FFTAnalyzer::update(const void* buffer, size_t size)
+{
+  int frameSize = (_bitsPerSample / 8) * _channels;
+  int frames = size / frameSize;
+  const uint8_t* src = (const uint8_t*)buffer;
+
+  if (_zoomBuffer) {
+    zoomUpdate(src, frames);
+    return;
+  }
+
+  if (_hopSize == 0) {
+    _framePosition += frames;
+
+    if (frames > _length) {
+      // more samples than buffer size, cap
+      src += (frames - _length) * frameSize;
+      frames = _length;
+    }
+
+    writeHistory(src, frames);
+    transform();
+    frameComputed();
+    return;
+  }
+
+  while (frames > 0) {
+    int chunk = _hopSize - _hopFrames;
+    if (chunk > frames) {
+      chunk = frames;
+    }
+
+    // only the last _length frames of a hop end up in the transform
+    int skip = (_hopSize - _length) - _hopFrames;
+    if (skip > chunk) {
+      skip = chunk;
+    }
+    if (skip < 0) {
+      skip = 0;
+    }
+
+    writeHistory(src + skip * frameSize, chunk - skip);
+
+    src += chunk * frameSize;
+    frames -= chunk;
+    _hopFrames += chunk;
+    _framePosition += chunk;
+
+    if (_hopFrames == _hopSize) {
+      _hopFrames = 0;
+      transform();
+      frameComputed();
+    }
+  }
+}
+
+void FFTAnalyzer::frameComputed()
+{
+  if (_averageBuffer && !averageSpectrum()) {
+    // the averaging period is not over yet
+    return;
+  }
+
+  if (_spectrogramBuffer) {
+    storeFrame();
+  }
+
+  if (_peakBuffer) {
+    findPeaks();
+  }
+
+  spectrumComputed();
+
+  if (_available < 0x7fff) {
+    _available++;
+  }
+}
+
+/*
+ * Welch averaging of the power spectrum just computed into _averageBuffer:
+ * avg += (power - avg) / (n + 1), with n the spectra already in the average. The
+ * linear average restarts every period, the exponential one keeps n at most
+ * _averagingFrames - 1, a running mean until then. At the end of a period the
+ * average is converted to the output format behind the running average.
+ * Returns 1 when a period ended.
+ */
+int FFTAnalyzer::averageSpectrum()
+{
+  int bins = binCount();
+  float* average = _averageBuffer;
+  float* result = _averageBuffer + bins;
+  int n = (_averaging == FFT_AVERAGING_LINEAR) ? _averagedFrames : _averageCount;
+  float weight = 1.0f / (n + 1);
+
+  for (int i = 0; i < bins; i++) {
+    average[i] += (transformValue(i) - average[i]) * weight;
+  }
+
+  if (_averageCount < _averagingFrames - 1) {
+    _averageCount++;
+  }
+
+  if (++_averagedFrames < _averagingFrames) {
+    return 0;
+  }
+
+  _averagedFrames = 0;
+
+  if (_output == FFT_OUTPUT_POWER) {
+    memcpy(result, average, bins * sizeof(float));
+  } else if (_output == FFT_OUTPUT_DB) {
+    for (int i = 0; i < bins; i++) {
+      result[i] = power_to_db(average[i]);
+    }
+  } else {
+    #ifdef ESP_PLATFORM
+      float scale = 1.0f;
+    #else
+      // arm_cmplx_mag_squared_q15/q31 return |X|^2 / 2^17 or / 2^33 of the raw
+      // fixed point values, arm_cmplx_mag_* return |X| / 2; the zoom transform is float
+      float scale = _zoomBuffer ? 1.0f : (_bitsPerSample == 16) ? 131072.0f * 0.25f : 8589934592.0f * 0.25f;
+    #endif
+
+    for (int i = 0; i < bins; i++) {
+      result[i] = sqrtf(average[i] * scale);
+    }
+  }
+
+  return 1;
+}
+
+// copy the spectrum to the next ring slot in the output format, then publish its sequence number
+void FFTAnalyzer::storeFrame()
+{
+  int bins = binCount();
+  int next = _spectrogramSlot + 1;
+
+  if (next == _spectrogramFrames) {
+    next = 0;
+  }
+
+  float* slot = _spectrogramBuffer + next * bins;
+
+  for (int i = 0; i < bins; i++) {
+    slot[i] = spectrumValue(i);
+  }
+
+  _spectrogramSlot = next;
+  // 0 is skipped, it names no spectrum
+  if (++_spectrogramSequence == 0) {
+    _spectrogramSequence = 1;
+  }
+}
+
+/*
+ * 1. One pass over all bins but the outer two keeps the _peakSlots highest local maxima,
+ *    sorted by insertion
+ * 2. Refine every peak with a parabola through the log of the three bins, which fits
+ *    the main lobe of the windows far better than the linear values:
+ *    delta = (a - c) / (2 * (a - 2b + c)), height = b - (a - c) * delta / 4
+ */
+void FFTAnalyzer::findPeaks()
+{
+  int bins = binCount();
+  int count = 0;
+  float previous = spectrumValue(0);
+  float current = spectrumValue(1);
+
+  for (int k = 1; k < bins - 1; k++) {
+    float next = spectrumValue(k + 1);
+
+    if (current > previous && current >= next
+        && (count < _peakSlots || current > _peakBuffer[count - 1].value)) {
+      int i = (count < _peakSlots) ? count++ : count - 1;
+
+      while (i > 0 && _peakBuffer[i - 1].value < current) {
+        _peakBuffer[i] = _peakBuffer[i - 1];
+        i--;
+      }
+
+      _peakBuffer[i].value = current;
+      _peakBuffer[i].bin = k;
+    }
+
+    previous = current;
+    current = next;
+  }
+
+  for (int i = 0; i < count; i++) {
+    FFTPeak* peak = &_peakBuffer[i];
+    int k = (int)peak->bin;
+    float a = spectrumValue(k - 1);
+    float b = peak->value;
+    float c = spectrumValue(k + 1);
+
+    if (_output != FFT_OUTPUT_DB) {
+      // magnitudes and powers are positive here, the minimum keeps silent bins finite
+      a = logf(a > FLT_MIN ? a : FLT_MIN);
+      b = logf(b);
+      c = logf(c > FLT_MIN ? c : FLT_MIN);
+    }
+
+    float curvature = a - 2.0f * b + c;
+    float delta = (curvature < 0.0f) ? 0.5f * (a - c) / curvature : 0.0f;
+    float height = b - 0.25f * (a - c) * delta;
+
+    peak->bin = k + delta;
+    peak->frequency = binFrequency(peak->bin);
+    peak->value = (_output == FFT_OUTPUT_DB) ? height : expf(height);
+  }
+
+  _peakCount = count;
+}
+
+// append frames to the circular history, wrapping at its end
+void FFTAnalyzer::writeHistory(const uint8_t* buffer, int frames)
+{
+  int sampleSize = _bitsPerSample / 8;
+
+  while (frames > 0) {
+    int chunk = _length - _sampleIndex;
+    if (chunk > frames) {
+      chunk = frames;
+    }
+
+    uint8_t* dst = ((uint8_t*)_sampleBuffer) + _sampleIndex * sampleSize;
+
+    if (_channels == 2) {
+      // average the stereo samples to mono
+      if (_bitsPerSample == 16) {
+        const int16_t *src = (const int16_t*)buffer;
+        int16_t* out = (int16_t*)dst;
+
+        for (int i = 0; i < chunk; i++) {
+          *out = (*src++) / 2;
+
+          *out += (*src++) / 2;
+
+          out++;
+        }
+      } else { // 32 bit
+        const int32_t *src = (const int32_t*)buffer;
+        int32_t* out = (int32_t*)dst;
+
+        for (int i = 0; i < chunk; i++) {
+          *out = *src / 2;
+
+          src++;
+          *out += *src / 2;
+
+          src++;
+
+          out++;
+        }
+      }
+    } else {
+      memcpy(dst, buffer, chunk * sampleSize);
+    }
+
+    buffer += chunk * sampleSize * _channels;
+    frames -= chunk;
+    _sampleIndex += chunk;
+    if (_sampleIndex == _length) {
+      _sampleIndex = 0;
+    }
+  }
+}
+
+// unroll the circular history, oldest sample first, into the FFT input
+void FFTAnalyzer::readHistory(void* output)
+{
+  // the oldest sample sits at the write position
+  int tail = _length - _sampleIndex;
+
+  copyHistory(_sampleIndex, tail, output, 0);
+  copyHistory(0, _sampleIndex, output, tail);
+}
+
+// copy count history samples starting at from to the FFT input starting at to,
+// applying the window and the sample format conversion in the same pass
+void FFTAnalyzer::copyHistory(int from, int count, void* output, int to)
+{
+  if (_bitsPerSample == 16) {
+    int16_t* src = ((int16_t*)_sampleBuffer) + from;
+    int16_t* dst = ((int16_t*)output) + to;
+
+    if (_windowBuffer == NULL) {
+      memcpy(dst, src, count * sizeof(int16_t));
+    } else {
+      #ifdef ESP_PLATFORM
+        window_int16(src, ((int16_t*)_windowBuffer) + to, dst, count);
+      #else
+        arm_mult_q15(src, ((q15_t*)_windowBuffer) + to, dst, count);
+      #endif
+    }
+  } else {
+    int32_t* src = ((int32_t*)_sampleBuffer) + from;
+
+    #ifdef ESP_PLATFORM
+      float* window = _windowBuffer ? ((float*)_windowBuffer) + to : NULL;
+
+      real_int32_to_packed_float(src, count, ((float*)output) + to, window);
+    #else
+      q31_t* dst = ((q31_t*)output) + to;
+
+      if (_windowBuffer == NULL) {
+        memcpy(dst, src, count * sizeof(q31_t));
+      } else {
+        arm_mult_q31(src, ((q31_t*)_windowBuffer) + to, dst, count);
+      }
+    #endif
+  }
+}
+
+// what transform() writes to _spectrumBuffer, averaging needs the power
+FFTOutput FFTAnalyzer::transformOutput()
+{
+  return _averageBuffer ? FFT_OUTPUT_POWER : _output;
+}
+
+void FFTAnalyzer::transform()
+{
+  #ifdef ESP_PLATFORM
+    // real input FFT: the _length real samples are packed as _length / 2 complex
+    // points, transformed with a half size FFT and split into bins 0.._length / 2
+    int halfLength = _length / 2;
+
+    if (_bitsPerSample == 16){
+      int16_t *real_buffer = (int16_t*)_fftBuffer;
+      int16_t *twiddles = (int16_t*)_twiddleBuffer;
+
+      // interleaved Re, Im pairs of even and odd samples are the samples themselves
+      readHistory(real_buffer);
+      #if defined ESP32
+        dsps_fft2r_sc16_ae32_(real_buffer, halfLength, twiddles); // FFT using 16-bit fixed point optimized for ESP32
+      #elif defined ESP32S2
+        dsps_fft2r_sc16_ansi_(real_buffer, halfLength, twiddles); // FFT using 16-bit fixed point
+      #endif
+      if (_storageBitReverse) {
+        bit_rev_table_int16(real_buffer, halfLength);
+      } else {
+        dsps_bit_rev_sc16_ansi(real_buffer, halfLength);
+      }
+      fft_split_real_int16(real_buffer, twiddles + halfLength, _length);
+
+      // Nyquist is packed in Im of bin 0, it gets its own magnitude
+      int16_t nyquist[2] = { real_buffer[1], 0 };
+
+      real_buffer[1] = 0;
+      magnitude_int16(real_buffer, (float*)_spectrumBuffer, halfLength);
+      magnitude_int16(nyquist, ((float*)_spectrumBuffer) + halfLength, 1);
+    } else { // assuming 32 bit input
+      float *real_buffer = (float*)_fftBuffer;
+      float *twiddles = (float*)_twiddleBuffer;
+
+      readHistory(real_buffer);
+      #if defined ESP32
+        dsps_fft2r_fc32_ae32_(real_buffer, halfLength, twiddles); // FFT using 32-bit floating point optimized for ESP32
+      #elif defined ESP32S2
+        dsps_fft2r_fc32_ansi_(real_buffer, halfLength, twiddles); // FFT using 32-bit floating point
+      #endif
+      if (_storageBitReverse) {
+        bit_rev_table_float(real_buffer, halfLength);
+      } else {
+        dsps_bit_rev_fc32_ansi(real_buffer, halfLength);
+      }
+      fft_split_real_float(real_buffer, twiddles + halfLength, _length);
+
+      // Nyquist is packed in Im of bin 0, it gets its own magnitude
+      float nyquist[2] = { real_buffer[1], 0.0f };
+
+      real_buffer[1] = 0.0f;
+      magnitude_float(real_buffer, (float*)_spectrumBuffer, halfLength);
+      magnitude_float(nyquist, ((float*)_spectrumBuffer) + halfLength, 1);
+    }
+  #else
+    // arm_rfft_* modifies its input, so it gets a linear copy of the history
+    readHistory(_inputBuffer);
+
+    // the upper half of a real input spectrum mirrors the lower one, only DC .. Nyquist is kept
+    int bins = _length / 2 + 1;
+
+    if (_bitsPerSample == 16) {
+      arm_rfft_q15(&_S15, (q15_t*)_inputBuffer, (q15_t*)_fftBuffer);
+
+      if (transformOutput() == FFT_OUTPUT_MAGNITUDE) {
+        arm_cmplx_mag_q15((q15_t*)_fftBuffer, (q15_t*)_spectrumBuffer, bins);
+      } else {
+        // power in 3.13 format, decibels are computed from it when the spectrum is read
+        arm_cmplx_mag_squared_q15((q15_t*)_fftBuffer, (q15_t*)_spectrumBuffer, bins);
+      }
+    } else {
+      //           struct   input( is modified)             output
+      arm_rfft_q31(&_S31, (q31_t*)_inputBuffer, (q31_t*)_fftBuffer);
+
+      if (transformOutput() == FFT_OUTPUT_MAGNITUDE) {
+        // _spectrumBuffer[n] = sqrt(_fftBuffer[(2*n)+0]^2 + _fftBuffer[(2*n)+1]^2);
+        arm_cmplx_mag_q31((q31_t*)_fftBuffer, (q31_t*) _spectrumBuffer, bins);
+      } else {
+        // power in 3.29 format, decibels are computed from it when the spectrum is read
+        arm_cmplx_mag_squared_q31((q31_t*)_fftBuffer, (q31_t*)_spectrumBuffer, bins);
+      }
+    }
+  #endif // #ifdef ESP_PLATFORM
+}
+
+#ifdef ESP_PLATFORM
+// convert int32_t array with real members to float, keeping the interleaved layout
+// from input[0]=x[0], input[1]=x[1], ...
+// to output[0]=Re[0]=x[0], output[1]=Im[0]=x[1], output[2]=Re[1]=x[2], ...
+// the output holds length / 2 complex points for the half size FFT,
+// window, when not NULL, is multiplied in on the way
+void FFTAnalyzer::real_int32_to_packed_float(int32_t* input, int length, float* output, float* window){
+  if (window == NULL) {
+    for(int i = 0 ; i < length; ++i){
+      output[i] = (float)input[i];
+    }
+  } else {
+    for(int i = 0 ; i < length; ++i){
+      output[i] = (float)input[i] * window[i];
+    }
+  }
+}
+
+// multiply int16_t samples by Q15 window coefficients
+void FFTAnalyzer::window_int16(int16_t* input, int16_t* window, int16_t* output, int length){
   for(int i = 0 ; i < length; ++i){
-    output[i*2] = input[i]; // Re
-    output[i*2+1] = 0; // Im=0
+    output[i] = (int16_t)(((int32_t)input[i] * window[i]) >> 15);
+  }
+}
+
+// bit reversal reordering of length complex points using the precomputed
+// permutation of StaticFFTAnalyzer instead of computing the indices
+void FFTAnalyzer::bit_rev_table_int16(int16_t* buffer, int length){
+  for (int i = 0; i < length; i++) {
+    int j = _storageBitReverse[i];
+
+    if (i < j) {
+      int16_t re = buffer[2*i];
+      int16_t im = buffer[2*i+1];
+
+      buffer[2*i] = buffer[2*j];
+      buffer[2*i+1] = buffer[2*j+1];
+      buffer[2*j] = re;
+      buffer[2*j+1] = im;
+    }
+  }
+}
+
+void FFTAnalyzer::bit_rev_table_float(float* buffer, int length){
+  for (int i = 0; i < length; i++) {
+    int j = _storageBitReverse[i];
+
+    if (i < j) {
+      float re = buffer[2*i];
+      float im = buffer[2*i+1];
+
+      buffer[2*i] = buffer[2*j];
+      buffer[2*i+1] = buffer[2*j+1];
+      buffer[2*j] = re;
+      buffer[2*j+1] = im;
+    }
+  }
+}
+#endif // #ifdef ESP_PLATFORM
+
+#ifdef ESP_PLATFORM
+// bit by bit integer square root, exact for the 32-bit power of an sc16 bin
+static inline uint32_t isqrt32(uint32_t x)
+{
+  uint32_t root = 0;
+  uint32_t bit;
+
+  if (x == 0) {
+    return 0;
+  }
+
+  // highest power of four not above x
+  bit = 1UL << ((31 - __builtin_clz(x)) & ~1);
+
+  while (bit) {
+    if (x >= root + bit) {
+      x -= root + bit;
+      root = (root >> 1) + bit;
+    } else {
+      root >>= 1;
+    }
+    bit >>= 2;
+  }
+
+  return root;
+}
+
+void FFTAnalyzer::magnitude_int16(int16_t *pSrc, float *pDst, uint32_t numSamples){
+  FFTOutput output = transformOutput();
+
+  if (output == FFT_OUTPUT_POWER) {
+    int16_cmplx_mag_squared(pSrc, pDst, numSamples);
+  } else if (output == FFT_OUTPUT_DB) {
+    int16_cmplx_mag_db(pSrc, pDst, numSamples);
+  } else {
+    int16_cmplx_mag(pSrc, pDst, numSamples);
+  }
+}
+#endif // #ifdef ESP_PLATFORM
+
+// float bins on both platforms: the ESP32 32-bit transform and the zoom transform
+void FFTAnalyzer::magnitude_float(float *pSrc, float *pDst, uint32_t numSamples){
+  FFTOutput output = transformOutput();
+
+  if (output == FFT_OUTPUT_POWER) {
+    float_cmplx_mag_squared(pSrc, pDst, numSamples);
+  } else if (output == FFT_OUTPUT_DB) {
+    float_cmplx_mag_db(pSrc, pDst, numSamples);
+  } else {
+    float_cmplx_mag(pSrc, pDst, numSamples);
   }
 }
 
@@ -328,14 +1795,60 @@ The pSrc points to the source data and pDst points to the where the result shoul
 numSamples specifies the number of complex samples in the input array and the data is stored
 in an interleaved fashion (real, imag, real, imag, ...).
 The input array has a total of 2*numSamples values; the output array has a total of numSamples values.
+The _squared variants skip the square root, the _db variants return 10*log10(re^2 + im^2).
 */
 void FFTAnalyzer::float_cmplx_mag(float *pSrc, float *pDst, uint32_t numSamples){
-  for (int n = 0; n < numSamples; n++) {
-    pDst[n] = (float)sqrt(pow(pSrc[(2*n)+0], 2.0) + pow(pSrc[(2*n)+1], 2.0));
+  for (uint32_t n = 0; n < numSamples; n++) {
+    float re = pSrc[(2*n)+0];
+    float im = pSrc[(2*n)+1];
+
+    pDst[n] = sqrtf(re * re + im * im);
+  }
+}
+
+void FFTAnalyzer::float_cmplx_mag_squared(float *pSrc, float *pDst, uint32_t numSamples){
+  for (uint32_t n = 0; n < numSamples; n++) {
+    float re = pSrc[(2*n)+0];
+    float im = pSrc[(2*n)+1];
+
+    pDst[n] = re * re + im * im;
   }
 }
+
+void FFTAnalyzer::float_cmplx_mag_db(float *pSrc, float *pDst, uint32_t numSamples){
+  for (uint32_t n = 0; n < numSamples; n++) {
+    float re = pSrc[(2*n)+0];
+    float im = pSrc[(2*n)+1];
+
+    pDst[n] = power_to_db(re * re + im * im);
+  }
+}
+
+#ifdef ESP_PLATFORM
 void FFTAnalyzer::int16_cmplx_mag(int16_t *pSrc, float *pDst, uint32_t numSamples){
-  for (int n = 0; n < numSamples; n++) {
-      pDst[n] = (float)sqrt(pow(pSrc[(2*n)+0], 2.0) + pow(pSrc[(2*n)+1], 2.0));
+  for (uint32_t n = 0; n < numSamples; n++) {
+    int32_t re = pSrc[(2*n)+0];
+    int32_t im = pSrc[(2*n)+1];
+
+    pDst[n] = (float)isqrt32((uint32_t)(re * re) + (uint32_t)(im * im));
+  }
+}
+
+void FFTAnalyzer::int16_cmplx_mag_squared(int16_t *pSrc, float *pDst, uint32_t numSamples){
+  for (uint32_t n = 0; n < numSamples; n++) {
+    int32_t re = pSrc[(2*n)+0];
+    int32_t im = pSrc[(2*n)+1];
+
+    pDst[n] = (float)((uint32_t)(re * re) + (uint32_t)(im * im));
+  }
+}
+
+void FFTAnalyzer::int16_cmplx_mag_db(int16_t *pSrc, float *pDst, uint32_t numSamples){
+  for (uint32_t n = 0; n < numSamples; n++) {
+    int32_t re = pSrc[(2*n)+0];
+    int32_t im = pSrc[(2*n)+1];
+
+    pDst[n] = power_to_db((float)((uint32_t)(re * re) + (uint32_t)(im * im)));
   }
 }
+#endif // #ifdef ESP_PLATFORM
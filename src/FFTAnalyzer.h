@@ -28,33 +28,188 @@
 #else
   #define ARM_MATH_CM0PLUS
   #include <arm_math.h>
+  #include <arm_const_structs.h>
 #endif // #ifdef ESP_PLATFORM
 
 #include "AudioAnalyzer.h"
 #include <cstring>
 
+// low-pass and decimate stages of the zoom, each one decimates by at most 16
+#define FFT_ZOOM_MAX_STAGES 4
+
+enum FFTWindow {
+  FFT_WINDOW_NONE = 0, // rectangular, the default
+  FFT_WINDOW_HANN,
+  FFT_WINDOW_HAMMING,
+  FFT_WINDOW_BLACKMAN_HARRIS, // 4 term, -92 dB side lobes
+  FFT_WINDOW_FLAT_TOP // accurate peak amplitudes, wide main lobe
+};
+
+enum FFTOutput {
+  FFT_OUTPUT_MAGNITUDE = 0, // |X[k]|, the default
+  FFT_OUTPUT_POWER, // |X[k]|^2
+  FFT_OUTPUT_DB // 10*log10(|X[k]|^2)
+};
+
+enum FFTAveraging {
+  FFT_AVERAGING_NONE = 0, // every spectrum is reported, the default
+  FFT_AVERAGING_LINEAR, // mean power of each block of frames spectra
+  FFT_AVERAGING_EXPONENTIAL // newest spectrum weighted 1 / frames, reported every frames spectra
+};
+
+struct FFTPeak {
+  float frequency; // Hz, refined between bins
+  float bin; // fractional bin index
+  float value; // interpolated peak height in the output format
+};
+
 class FFTAnalyzer : public AudioAnalyzer
 {
 public:
   FFTAnalyzer(int length);
   virtual ~FFTAnalyzer();
 
-  int available();
+  // frames between two transforms, 0 transforms once per block read from the input
+  void setHopSize(int hopSize);
+  // hop size as the percentage of the FFT length shared by consecutive transforms
+  void setOverlap(int percent);
+  // window applied to the samples before the transform
+  int setWindow(FFTWindow window);
+  // what the spectrum bins hold
+  void setOutput(FFTOutput output);
+  // average the power of consecutive spectra (Welch), available() then counts averaging periods
+  int setAveraging(FFTAveraging averaging, int frames);
+
+  int available(); // number of spectra computed since the last read, only the newest is kept
+  // both copy at most the length / 2 + 1 bins from DC to Nyquist
   int read(int spectrum[], int size); // original
   int readFloat(float spectrum[], int size);
 
+  // keep the newest frames spectra in a ring of frames x (length / 2 + 1) floats, 0 turns it off
+  int setSpectrogram(int frames);
+  // sequence number of the newest spectrum in the ring, the first one is 1, 0 before any;
+  // after 2^32 - 1 it starts over at 1, 0 never names a spectrum
+  uint32_t frameSequence();
+  // bins of spectrum number sequence, in the output format, or NULL once it has been overwritten;
+  // the view is not copied, it stays valid until frames newer spectra have been computed
+  const float* frame(uint32_t sequence);
+  // view of the spectrum after *sequence, the oldest one still in the ring, NULL when the reader
+  // is up to date; *sequence becomes its number and *overwritten counts the spectra it missed.
+  // Every reader keeps its own sequence, starting from 0 or from frameSequence()
+  const float* nextFrame(uint32_t* sequence, uint32_t* overwritten = NULL);
+
+  // analyse only centerFrequency +- bandwidth / 2: the input is mixed down to 0 Hz, low-pass
+  // filtered and decimated by sampleRate / bandwidth, rounded down to a product of factors up to 16,
+  // then a complex FFT gives length bins from the lowest to the highest frequency of the band.
+  // Only the zoom buffers are allocated. Call before input(), bandwidth 0 turns it off
+  int setZoom(float centerFrequency, float bandwidth);
+  float binFrequency(float bin); // frequency of a, possibly fractional, bin in Hz
+
+  // find the count highest local maxima of every spectrum, 0 turns it off
+  int setPeaks(int count);
+  // copies the peaks of the newest spectrum, highest first, clears available() as readFloat() does
+  int readPeaks(FFTPeak peaks[], int size);
+
+  size_t memoryUsage(); // bytes held by the analyzer buffers after configure
+
+  // bytes of buffer storage StaticFFTAnalyzer reserves for a length and sample size
+  static constexpr size_t storageSize(int length, int sampleSize) {
+    #ifdef ESP_PLATFORM
+      // history, FFT work area, window, spectrum, pull buffer
+      return 3 * storageAlign(length * sampleSize) + storageAlign((length / 2 + 1) * sizeof(float)) + storageAlign(length);
+    #else
+      // history, arm_rfft input, window, FFT output, spectrum
+      return 3 * storageAlign(length * sampleSize) + storageAlign(length * 2 * sampleSize) + storageAlign((length / 2 + 1) * sampleSize);
+    #endif
+  }
+
 protected:
+  // buffers carved out of storage and, on ESP32, constant twiddle and
+  // bit reversal tables instead of heap allocations, see StaticFFTAnalyzer
+  FFTAnalyzer(int length, int bitsPerSample, uint8_t* storage, const void* twiddles, const uint16_t* bitReverse);
+
+  static constexpr size_t storageAlign(size_t size) {
+    return (size + 3) & ~(size_t)3;
+  }
+
   virtual int configure(AudioIn* input);
   virtual void update(const void* buffer, size_t size);
-  void real_int16_to_complex_int16(int16_t* input, int length, int16_t* output);
-  void real_uint32_to_complex_float(uint32_t* input, int length, float* output);
+  #ifdef ESP_PLATFORM
+    void real_int32_to_packed_float(int32_t* input, int length, float* output, float* window);
+    void window_int16(int16_t* input, int16_t* window, int16_t* output, int length);
+    void bit_rev_table_int16(int16_t* buffer, int length);
+    void bit_rev_table_float(float* buffer, int length);
+  #endif
+  void magnitude_float(float *pSrc, float *pDst, uint32_t numSamples);
   void float_cmplx_mag(float *pSrc, float *pDst, uint32_t numSamples);
-  void int16_cmplx_mag(int16_t *pSrc, float *pDst, uint32_t numSamples);
+  void float_cmplx_mag_squared(float *pSrc, float *pDst, uint32_t numSamples);
+  void float_cmplx_mag_db(float *pSrc, float *pDst, uint32_t numSamples);
+  #ifdef ESP_PLATFORM
+    void int16_cmplx_mag(int16_t *pSrc, float *pDst, uint32_t numSamples);
+    void int16_cmplx_mag_squared(int16_t *pSrc, float *pDst, uint32_t numSamples);
+    void int16_cmplx_mag_db(int16_t *pSrc, float *pDst, uint32_t numSamples);
+    void magnitude_int16(int16_t *pSrc, float *pDst, uint32_t numSamples);
+  #endif
+  float spectrumValue(int bin);
+  // called after every transform, derived analyzers read the new bins with spectrumValue()
+  virtual void spectrumComputed();
+  // input frames taken in since configure, up to the newest sample of the last transform
+  uint32_t framePosition();
+  long sampleRate();
+  // setZoom() is on: length complex bins across the band instead of length / 2 + 1 real bins
+  bool zoomed();
+
+private:
+  void* allocate(int size);
+  void freeBuffers();
+  void writeHistory(const uint8_t* buffer, int frames);
+  void readHistory(void* output);
+  void copyHistory(int from, int count, void* output, int to);
+  int buildTransform();
+  int buildWindow();
+  int buildAveraging();
+  int buildSpectrogram();
+  void storeFrame();
+  const float* frameView(uint32_t sequence, uint32_t newest, int slot);
+  int buildPeaks();
+  void findPeaks();
+  int buildZoom();
+  void zoomLowPass(float* coefficients, int taps, int decimation);
+  void buildZoomWindow();
+  void zoomUpdate(const uint8_t* buffer, int frames);
+  int zoomDecimate(float* real, float* imag);
+  void zoomTransform();
+  float transformValue(int bin);
+  const float* floatSpectrum();
+  int binCount();
+  FFTOutput transformOutput();
+  void transform();
+  void frameComputed();
+  int averageSpectrum();
 
 private:
+  struct ZoomStage {
+    int decimation;
+    int taps; // 16 per decimation phase
+    int phase; // input samples since the last output
+    int delayIndex; // oldest sample of the delay line
+    float* coefficients;
+    float* delay; // complex delay line, stored twice so the taps read it in one run
+  };
+
   int _length;
+  long _sampleRate;
   int _bitsPerSample;
   int _channels;
+  int _hopSize;
+  int _hopFrames; // frames written since the last transform
+  uint32_t _framePosition;
+  FFTWindow _window;
+  FFTOutput _output;
+  FFTAveraging _averaging;
+  int _averagingFrames; // spectra per averaging period
+  int _averagedFrames; // spectra of the current period
+  int _averageCount; // spectra in the exponential average, up to _averagingFrames
 
   #ifndef ESP_PLATFORM
     arm_rfft_instance_q15 _S15;
@@ -62,13 +217,47 @@ private:
   #endif // #ifndef ESP_PLATFORM
 
   int _available;
-  void* _sampleBuffer;
+  void* _sampleBuffer; // circular history of the last _length mono samples
   int _sampleBufferSize;
+  int _sampleIndex; // write position, also the oldest sample in the history
   void* _fftBuffer;
   void* _spectrumBuffer;
-  #ifdef ESP_PLATFORM
+  void* _windowBuffer; // coefficients in the FFT input format, NULL for no window
+  float* _averageBuffer; // running power average, then the last period in the output format
+  float* _spectrogramBuffer; // ring of _spectrogramFrames spectra
+  int _spectrogramFrames;
+  uint32_t _spectrogramSequence; // newest spectrum in the ring, wraps from 2^32 - 1 to 1
+  int _spectrogramSlot; // ring slot of the newest spectrum
+  FFTPeak* _peakBuffer;
+  int _peakSlots;
+  int _peakCount; // peaks found in the newest spectrum
+  float _zoomCenter;
+  float _zoomBandwidth;
+  int _zoomDecimation; // product of the stage decimations
+  ZoomStage _zoomStages[FFT_ZOOM_MAX_STAGES];
+  int _zoomStageCount;
+  int _zoomHistoryIndex;
+  float _zoomMixer[2]; // e^(-j*w*n) for the next input frame
+  float _zoomStep[2]; // e^(-j*w)
+  float* _zoomBuffer; // owns all the zoom buffers below
+  float* _zoomHistory; // circular history of the last _length complex decimated samples
+  float* _zoomFFT;
+  float* _zoomWindow;
+  float* _zoomSpectrum;
+  size_t _memoryUsage;
+  uint8_t* _storage; // NULL unless the buffers are owned by StaticFFTAnalyzer
+  int _storageUsed;
+  int _storageBitsPerSample;
+  void* _storageWindow;
+  #ifndef ESP_PLATFORM
+    void* _inputBuffer;
+    const arm_cfft_instance_f32* _zoomInstance;
+  #else
+    void* _twiddleBuffer;
     uint8_t* _data_buffer;
-    AudioIn* _input;
+    const void* _storageTwiddles;
+    const uint16_t* _storageBitReverse;
+    float* _zoomTwiddles;
   #endif
 };
 
@@ -0,0 +1,185 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "AudioIn.h"
+
+#include "FFTBandAnalyzer.h"
+
+FFTBandAnalyzer::FFTBandAnalyzer(int length) :
+  FFTAnalyzer(length),
+  _available(0),
+  _bands(0),
+  _valueCount(0),
+  _weightCount(0),
+  _bandBuffer(NULL),
+  _weights(NULL),
+  _values(NULL)
+{
+}
+
+FFTBandAnalyzer::~FFTBandAnalyzer()
+{
+  detach();
+  freeBands();
+}
+
+int FFTBandAnalyzer::available()
+{
+  // pulls the input on ESP32
+  FFTAnalyzer::available();
+
+  return _available;
+}
+
+size_t FFTBandAnalyzer::memoryUsage()
+{
+  return FFTAnalyzer::memoryUsage() + _bands * sizeof(Band) + (_weightCount + _valueCount) * sizeof(float);
+}
+
+int FFTBandAnalyzer::buildBands(int bands, int values)
+{
+  freeBands();
+
+  _bandBuffer = (Band*)calloc(bands, sizeof(Band));
+  _values = (float*)calloc(values, sizeof(float));
+
+  if (_bandBuffer == NULL || _values == NULL) {
+    freeBands();
+
+    return 0;
+  }
+
+  _bands = bands;
+  _valueCount = values;
+  _available = 0;
+
+  return 1;
+}
+
+void FFTBandAnalyzer::setBandBins(int band, int firstBin, int lastBin)
+{
+  _bandBuffer[band].firstBin = firstBin;
+  _bandBuffer[band].bins = (lastBin >= firstBin) ? lastBin - firstBin + 1 : 0;
+}
+
+// the weight runs follow each other in band order
+int FFTBandAnalyzer::buildWeights()
+{
+  int weights = 0;
+
+  for (int m = 0; m < _bands; m++) {
+    _bandBuffer[m].weightIndex = weights;
+    weights += _bandBuffer[m].bins;
+  }
+
+  _weights = (float*)calloc(weights > 0 ? weights : 1, sizeof(float));
+
+  if (_weights == NULL) {
+    freeBands();
+
+    return 0;
+  }
+
+  _weightCount = weights;
+
+  return 1;
+}
+
+void FFTBandAnalyzer::freeBands()
+{
+  if (_bandBuffer) {
+    free(_bandBuffer);
+    _bandBuffer = NULL;
+  }
+
+  if (_weights) {
+    free(_weights);
+    _weights = NULL;
+  }
+
+  if (_values) {
+    free(_values);
+    _values = NULL;
+  }
+
+  _bands = 0;
+  _valueCount = 0;
+  _weightCount = 0;
+}
+
+int FFTBandAnalyzer::bandCount()
+{
+  return _bands;
+}
+
+int FFTBandAnalyzer::bandFirstBin(int band)
+{
+  return _bandBuffer[band].firstBin;
+}
+
+int FFTBandAnalyzer::bandBins(int band)
+{
+  return _bandBuffer[band].bins;
+}
+
+float* FFTBandAnalyzer::bandWeights(int band)
+{
+  return &_weights[_bandBuffer[band].weightIndex];
+}
+
+float FFTBandAnalyzer::bandPower(int band)
+{
+  const Band* b = &_bandBuffer[band];
+  const float* weight = &_weights[b->weightIndex];
+  float power = 0.0f;
+
+  for (int i = 0; i < b->bins; i++) {
+    power += weight[i] * spectrumValue(b->firstBin + i);
+  }
+
+  return power;
+}
+
+float* FFTBandAnalyzer::values()
+{
+  return _values;
+}
+
+void FFTBandAnalyzer::valuesComputed()
+{
+  if (_available < 0x7fff) {
+    _available++;
+  }
+}
+
+int FFTBandAnalyzer::readValues(float values[], int size, int count)
+{
+  if (!_available) {
+    return 0;
+  }
+
+  if (size > count) {
+    size = count;
+  }
+
+  memcpy(values, _values, sizeof(float) * size);
+
+  _available = 0;
+
+  return size;
+}
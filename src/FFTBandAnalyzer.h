@@ -0,0 +1,76 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef _FFT_BAND_ANALYZER_H_INCLUDED
+#define _FFT_BAND_ANALYZER_H_INCLUDED
+
+#include <Arduino.h>
+
+#include "FFTAnalyzer.h"
+
+/*
+ * Base of the analyzers that reduce every FFTAnalyzer spectrum to a few bands,
+ * each a weighted sum of a run of power bins. Only the non-zero weights are
+ * stored, band after band, and the values derived from the bands are read as
+ * one vector per hop.
+ */
+class FFTBandAnalyzer : public FFTAnalyzer
+{
+public:
+  virtual ~FFTBandAnalyzer();
+
+  int available(); // number of vectors computed since the last read, only the newest is kept
+
+  size_t memoryUsage(); // bytes of the FFT buffers plus the band table and the vector
+
+protected:
+  FFTBandAnalyzer(int length);
+
+  // in configure(): buildBands(), setBandBins() for every band, buildWeights(), then fill bandWeights()
+  int buildBands(int bands, int values);
+  void setBandBins(int band, int firstBin, int lastBin); // no bins when lastBin < firstBin
+  int buildWeights();
+  void freeBands();
+
+  int bandCount();
+  int bandFirstBin(int band);
+  int bandBins(int band);
+  float* bandWeights(int band);
+  float bandPower(int band); // weighted sum of the bins of the newest spectrum
+
+  float* values(); // the vector spectrumComputed() writes
+  void valuesComputed(); // counts the vector in available()
+  int readValues(float values[], int size, int count); // copies at most count values
+
+private:
+  struct Band {
+    int firstBin;
+    int bins;
+    int weightIndex; // first weight of the band in _weights
+  };
+
+  int _available;
+  int _bands;
+  int _valueCount;
+  int _weightCount;
+  Band* _bandBuffer;
+  float* _weights; // non-zero bin weights of all bands, band after band
+  float* _values;
+};
+
+#endif
@@ -0,0 +1,115 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "FFTSplit.h"
+
+#include <math.h>
+
+#ifndef M_PI
+  #define M_PI 3.14159265358979323846
+#endif
+
+// generate the e^(-j*2*pi*k/length) twiddles, k = 0 .. length / 4, used by the split step
+void fft_split_twiddles_int16(int16_t* twiddles, int length){
+  for (int k = 0; k <= length / 4; k++) {
+    float phase = 2.0f * (float)M_PI * k / length;
+
+    twiddles[2*k] = (int16_t)lroundf(32767.0f * cosf(phase));
+    twiddles[2*k+1] = (int16_t)lroundf(-32767.0f * sinf(phase));
+  }
+}
+
+void fft_split_twiddles_float(float* twiddles, int length){
+  for (int k = 0; k <= length / 4; k++) {
+    float phase = 2.0f * (float)M_PI * k / length;
+
+    twiddles[2*k] = cosf(phase);
+    twiddles[2*k+1] = -sinf(phase);
+  }
+}
+
+/*
+Turns the length / 2 point FFT Z[k] of the packed samples z[m] = x[2m] + j*x[2m+1] into
+the first half of the length point FFT X[k] of the real samples x[n], in place:
+  E[k] = (Z[k] + conj(Z[M-k])) / 2,  O[k] = -j * (Z[k] - conj(Z[M-k])) / 2,  M = length / 2
+  X[k] = E[k] + W^k * O[k],  X[M-k] = conj(E[k] - W^k * O[k]),  W = e^(-j*2*pi/length)
+X[0] and X[M] are both real, they are returned packed as Re and Im of buffer[0].
+The sc16 kernels scale each stage by 1/2, one more halving keeps the bins equal
+to the ones of the full size complex FFT.
+*/
+void fft_split_real_int16(int16_t* buffer, const int16_t* twiddles, int length){
+  int half = length / 2;
+  int32_t re = buffer[0];
+  int32_t im = buffer[1];
+
+  buffer[0] = (int16_t)((re + im) >> 1);
+  buffer[1] = (int16_t)((re - im) >> 1);
+
+  for (int k = 1; k <= half / 2; k++) {
+    int16_t* a = &buffer[2*k];
+    int16_t* b = &buffer[2*(half-k)];
+    int32_t wr = twiddles[2*k];
+    int32_t wi = twiddles[2*k+1];
+
+    int32_t er = (a[0] + b[0]) >> 1;
+    int32_t ei = (a[1] - b[1]) >> 1;
+    int32_t or_ = (a[1] + b[1]) >> 1;
+    int32_t oi = (b[0] - a[0]) >> 1;
+
+    int32_t tr = ((wr * or_) >> 15) - ((wi * oi) >> 15);
+    int32_t ti = ((wr * oi) >> 15) + ((wi * or_) >> 15);
+
+    a[0] = (int16_t)((er + tr) >> 1);
+    a[1] = (int16_t)((ei + ti) >> 1);
+    if (k != half - k) {
+      b[0] = (int16_t)((er - tr) >> 1);
+      b[1] = (int16_t)((ti - ei) >> 1);
+    }
+  }
+}
+
+void fft_split_real_float(float* buffer, const float* twiddles, int length){
+  int half = length / 2;
+  float re = buffer[0];
+  float im = buffer[1];
+
+  buffer[0] = re + im;
+  buffer[1] = re - im;
+
+  for (int k = 1; k <= half / 2; k++) {
+    float* a = &buffer[2*k];
+    float* b = &buffer[2*(half-k)];
+    float wr = twiddles[2*k];
+    float wi = twiddles[2*k+1];
+
+    float er = 0.5f * (a[0] + b[0]);
+    float ei = 0.5f * (a[1] - b[1]);
+    float or_ = 0.5f * (a[1] + b[1]);
+    float oi = 0.5f * (b[0] - a[0]);
+
+    float tr = wr * or_ - wi * oi;
+    float ti = wr * oi + wi * or_;
+
+    a[0] = er + tr;
+    a[1] = ei + ti;
+    if (k != half - k) {
+      b[0] = er - tr;
+      b[1] = ti - ei;
+    }
+  }
+}
@@ -0,0 +1,36 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef _FFT_SPLIT_H_INCLUDED
+#define _FFT_SPLIT_H_INCLUDED
+
+#include <stdint.h>
+
+// Real input FFT split step used by the ESP32 FFTAnalyzer path: a length / 2 point
+// complex FFT of the packed samples is turned into bins 0 .. length / 2 of the length
+// point FFT of the real samples. Plain C, so extras/test can check it on the host.
+
+// length / 4 + 1 complex twiddles e^(-j*2*pi*k/length)
+void fft_split_twiddles_int16(int16_t* twiddles, int length);
+void fft_split_twiddles_float(float* twiddles, int length);
+
+// in place, DC and Nyquist are returned as Re and Im of bin 0
+void fft_split_real_int16(int16_t* buffer, const int16_t* twiddles, int length);
+void fft_split_real_float(float* buffer, const float* twiddles, int length);
+
+#endif
@@ -0,0 +1,297 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "AudioIn.h"
+
+#include "GoertzelAnalyzer.h"
+
+#define GOERTZEL_CHUNK (int)(sizeof(_samples) / sizeof(_samples[0]))
+
+// the frequencies are only read when the analyzer is configured by input()
+GoertzelAnalyzer::GoertzelAnalyzer(const float frequencies[], int count, int blockSize) :
+  _frequencies(frequencies),
+  _count(count),
+  _blockSize(blockSize),
+  _bitsPerSample(-1),
+  _channels(-1),
+  _available(0),
+  _blockFrames(0),
+  _filters(NULL),
+  _scale(1.0f)
+#ifndef ESP_PLATFORM
+  , _shift(0)
+#endif
+{
+}
+
+GoertzelAnalyzer::~GoertzelAnalyzer()
+{
+  detach();
+
+  if (_filters) {
+    free(_filters);
+  }
+}
+
+int GoertzelAnalyzer::available()
+{
+  #ifdef ESP_PLATFORM
+    if (_attachedInput == NULL) {
+      return 0;
+    }
+
+    _attachedInput->read(_data_buffer, sizeof(_data_buffer));
+  #endif
+
+  return _available;
+}
+
+int GoertzelAnalyzer::read(float power[], int size)
+{
+  if (!_available) {
+    return 0;
+  }
+
+  if (size > _count) {
+    size = _count;
+  }
+
+  for (int i = 0; i < size; i++) {
+    power[i] = _filters[i].power;
+  }
+
+  _available = 0;
+
+  return size;
+}
+
+int GoertzelAnalyzer::configure(AudioIn* input)
+{
+  int bitsPerSample = input->bitsPerSample();
+  int channels = input->channels();
+  long sampleRate = input->sampleRate();
+
+  if (bitsPerSample != 16 && bitsPerSample != 32) {
+    return 0;
+  }
+
+  if (channels != 1 && channels != 2) {
+    return 0;
+  }
+
+  if (_count <= 0 || _blockSize <= 0 || sampleRate <= 0) {
+    return 0;
+  }
+
+  if (_filters) {
+    free(_filters);
+  }
+
+  _filters = (Filter*)calloc(_count, sizeof(Filter));
+
+  if (_filters == NULL) {
+    return 0;
+  }
+
+  _bitsPerSample = bitsPerSample;
+  _channels = channels;
+  _blockFrames = 0;
+
+  // |X|^2 of a sine of amplitude A at the filter frequency is about (A * N / 2)^2
+  _scale = 4.0f / ((float)_blockSize * (float)_blockSize);
+
+  #ifndef ESP_PLATFORM
+    // the filter state of a tone at w grows up to about A * N / sin(w), and
+    // up to A * N^2 / 2 towards DC, shift the input to keep it below 2^29
+    float growth = 0.0f;
+
+    for (int i = 0; i < _count; i++) {
+      float w = 2.0f * PI * _frequencies[i] / sampleRate;
+      float bound = (float)_blockSize / fabsf(sinf(w));
+      float dcBound = 0.5f * (float)_blockSize * (_blockSize + 1);
+
+      if (bound > dcBound) {
+        bound = dcBound;
+      }
+
+      if (bound > growth) {
+        growth = bound;
+      }
+    }
+
+    _shift = 0;
+    while (_shift < 15 && 32768.0f * growth / (float)(1L << _shift) >= 536870912.0f) {
+      _shift++;
+    }
+
+    _scale *= (float)(1L << _shift) * (float)(1L << _shift);
+    if (bitsPerSample == 32) {
+      // 32-bit samples are filtered as their upper 16 bits
+      _scale *= 65536.0f * 65536.0f;
+    }
+  #endif
+
+  for (int i = 0; i < _count; i++) {
+    #ifdef ESP_PLATFORM
+      _filters[i].coefficient = 2.0f * cosf(2.0f * PI * _frequencies[i] / sampleRate);
+    #else
+      // Q30 in double, a coarser coefficient moves low centre frequencies by several Hz;
+      // 2 * cos(0) does not fit and is clamped just below 2
+      double coefficient = 2.0 * cos(2.0 * PI * _frequencies[i] / sampleRate) * 1073741824.0;
+
+      _filters[i].coefficient = coefficient < 2147483647.0 ? (int32_t)lround(coefficient) : 2147483647L;
+    #endif
+  }
+
+  return 1;
+}
+
+/*
+ * 1. Split the block at the end of the current Goertzel block and in chunks of GOERTZEL_CHUNK frames
+ * 2. Average the chunk to mono once, in the format the filters use
+ * 3. Run every filter over the chunk: s[n] = x[n] + 2*cos(w)*s[n-1] - s[n-2]
+ * 4. At the end of a Goertzel block compute the powers and set up _available = 1
+ */
+void GoertzelAnalyzer::update(const void* buffer, size_t size)
+{
+  int frameSize = (_bitsPerSample / 8) * _channels;
+  int frames = size / frameSize;
+  const uint8_t* src = (const uint8_t*)buffer;
+
+  while (frames > 0) {
+    int chunk = _blockSize - _blockFrames;
+
+    if (chunk > frames) {
+      chunk = frames;
+    }
+
+    chunk = downmix(src, chunk);
+
+    for (int k = 0; k < _count; k++) {
+      Filter* filter = &_filters[k];
+
+      #ifdef ESP_PLATFORM
+        float coefficient = filter->coefficient;
+        float s1 = filter->s1;
+        float s2 = filter->s2;
+
+        for (int i = 0; i < chunk; i++) {
+          float s = _samples[i] + coefficient * s1 - s2;
+
+          s2 = s1;
+          s1 = s;
+        }
+      #else
+        int32_t coefficient = filter->coefficient;
+        int32_t s1 = filter->s1;
+        int32_t s2 = filter->s2;
+
+        for (int i = 0; i < chunk; i++) {
+          int32_t s = _samples[i] + (int32_t)(((int64_t)coefficient * s1) >> 30) - s2;
+
+          s2 = s1;
+          s1 = s;
+        }
+      #endif
+
+      filter->s1 = s1;
+      filter->s2 = s2;
+    }
+
+    src += chunk * frameSize;
+    frames -= chunk;
+    _blockFrames += chunk;
+
+    if (_blockFrames == _blockSize) {
+      finishBlock();
+    }
+  }
+}
+
+// average up to GOERTZEL_CHUNK frames to mono into _samples, returns the frames taken
+int GoertzelAnalyzer::downmix(const uint8_t* buffer, int frames)
+{
+  if (frames > GOERTZEL_CHUNK) {
+    frames = GOERTZEL_CHUNK;
+  }
+
+  if (_bitsPerSample == 16) {
+    const int16_t* src = (const int16_t*)buffer;
+
+    for (int i = 0; i < frames; i++) {
+      int32_t sample = *src++;
+
+      if (_channels == 2) {
+        sample = (sample + *src++) >> 1;
+      }
+
+      #ifdef ESP_PLATFORM
+        _samples[i] = sample;
+      #else
+        _samples[i] = sample >> _shift;
+      #endif
+    }
+  } else {
+    const int32_t* src = (const int32_t*)buffer;
+
+    for (int i = 0; i < frames; i++) {
+      #ifdef ESP_PLATFORM
+        float sample = *src++;
+
+        if (_channels == 2) {
+          sample = 0.5f * (sample + *src++);
+        }
+
+        _samples[i] = sample;
+      #else
+        int32_t sample = *src++ >> 16;
+
+        if (_channels == 2) {
+          sample = (sample + (*src++ >> 16)) >> 1;
+        }
+
+        _samples[i] = sample >> _shift;
+      #endif
+    }
+  }
+
+  return frames;
+}
+
+// P = s1^2 + s2^2 - 2*cos(w)*s1*s2, then restart the filters for the next block
+void GoertzelAnalyzer::finishBlock()
+{
+  for (int k = 0; k < _count; k++) {
+    Filter* filter = &_filters[k];
+    float s1 = filter->s1;
+    float s2 = filter->s2;
+
+    #ifdef ESP_PLATFORM
+      float coefficient = filter->coefficient;
+    #else
+      float coefficient = filter->coefficient / 1073741824.0f;
+    #endif
+
+    filter->power = (s1 * s1 + s2 * s2 - coefficient * s1 * s2) * _scale;
+    filter->s1 = 0;
+    filter->s2 = 0;
+  }
+
+  _blockFrames = 0;
+  _available = 1;
+}
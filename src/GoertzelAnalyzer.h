@@ -0,0 +1,86 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef _GOERTZEL_ANALYZER_H_INCLUDED
+#define _GOERTZEL_ANALYZER_H_INCLUDED
+
+#include <Arduino.h>
+
+#include "AudioAnalyzer.h"
+
+/*
+ * Power of a few target frequencies, computed with one Goertzel filter per
+ * frequency over blocks of blockSize frames. K frequencies cost O(blockSize * K)
+ * per block and two words of state each, instead of a full FFT and spectrum.
+ *
+ * On ESP32 the filters run in float, on SAMD in fixed point.
+ */
+class GoertzelAnalyzer : public AudioAnalyzer
+{
+public:
+  GoertzelAnalyzer(const float frequencies[], int count, int blockSize);
+  virtual ~GoertzelAnalyzer();
+
+  int available();
+  // power of each frequency over the last block, in squared sample units:
+  // a full scale 16-bit sine at one of the frequencies reads about 32767^2
+  int read(float power[], int size);
+
+protected:
+  virtual int configure(AudioIn* input);
+  virtual void update(const void* buffer, size_t size);
+
+private:
+  struct Filter {
+    #ifdef ESP_PLATFORM
+      float coefficient; // 2 * cos(w)
+      float s1;
+      float s2;
+    #else
+      int32_t coefficient; // 2 * cos(w) in Q30
+      int32_t s1;
+      int32_t s2;
+    #endif
+    float power;
+  };
+
+  int downmix(const uint8_t* buffer, int frames);
+  void finishBlock();
+
+private:
+  const float* _frequencies;
+  int _count;
+  int _blockSize;
+  int _bitsPerSample;
+  int _channels;
+  int _available;
+  int _blockFrames; // frames of the current block already filtered
+
+  Filter* _filters;
+  float _scale; // turns the filter state into squared sample units
+
+  #ifdef ESP_PLATFORM
+    float _samples[64]; // mono chunk shared by all filters
+    uint8_t _data_buffer[256];
+  #else
+    int32_t _samples[64];
+    int _shift; // input headroom so the fixed point state can not overflow
+  #endif
+};
+
+#endif
@@ -0,0 +1,486 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "AudioIn.h"
+
+#include "LoudnessAnalyzer.h"
+
+#define HISTOGRAM_BINS 750 // 0.1 LU bins from the -70 LUFS absolute gate to +5 LUFS
+#define RING_BLOCKS 30 // 100 ms blocks of the short-term loudness
+
+static float energy_to_loudness(float energy)
+{
+  return -0.691f + 10.0f * log10f(energy);
+}
+
+static void add_to_histogram(uint16_t* histogram, float loudness)
+{
+  // absolute gate
+  if (!(loudness >= -70.0f)) {
+    return;
+  }
+
+  int bin = (int)((loudness + 70.0f) * 10.0f);
+
+  if (bin >= HISTOGRAM_BINS) {
+    bin = HISTOGRAM_BINS - 1;
+  }
+
+  if (histogram[bin] == 0xffff) {
+    // keep the proportions, the counts only weight the bins against each other
+    for (int i = 0; i < HISTOGRAM_BINS; i++) {
+      histogram[i] = (histogram[i] + 1) >> 1;
+    }
+  }
+
+  histogram[bin]++;
+}
+
+// first bin of the values at or above loudness
+static int histogram_bin(float loudness)
+{
+  int bin = (int)floorf((loudness + 70.0f) * 10.0f);
+
+  if (bin < 0) {
+    return 0;
+  }
+
+  return (bin > HISTOGRAM_BINS) ? HISTOGRAM_BINS : bin;
+}
+
+// mean energy of the values from bin from up, each value taken at the centre of its bin
+static float histogram_energy(const uint16_t* histogram, int from, uint32_t* count)
+{
+  // 10^((L + 0.691) / 10) at the centre of bin from, then a factor 10^0.01 per bin
+  float energy = powf(10.0f, (-70.0f + 0.1f * from + 0.05f + 0.691f) / 10.0f);
+  const float step = 1.02329299f;
+  float sum = 0.0f;
+  uint32_t total = 0;
+
+  for (int i = from; i < HISTOGRAM_BINS; i++) {
+    sum += histogram[i] * energy;
+    total += histogram[i];
+    energy *= step;
+  }
+
+  *count = total;
+
+  return total ? sum / total : 0.0f;
+}
+
+LoudnessAnalyzer::LoudnessAnalyzer() :
+  _bitsPerSample(-1),
+  _channels(-1),
+  _available(0),
+  _blockSize(0),
+  _blockFrames(0),
+  _channelStates(NULL),
+  _blockIndex(0),
+  _blocks(0),
+  _momentary(-INFINITY),
+  _shortTerm(-INFINITY),
+  _momentaryHistogram(NULL),
+  _shortTermHistogram(NULL),
+  _memoryUsage(0)
+{
+  memset(_blockEnergies, 0x00, sizeof(_blockEnergies));
+}
+
+LoudnessAnalyzer::~LoudnessAnalyzer()
+{
+  detach();
+  freeBuffers();
+}
+
+int LoudnessAnalyzer::available()
+{
+  #ifdef ESP_PLATFORM
+    if (_attachedInput == NULL) {
+      return 0;
+    }
+
+    _attachedInput->read(_data_buffer, sizeof(_data_buffer));
+  #endif
+
+  return _available;
+}
+
+int LoudnessAnalyzer::read(LoudnessLevels* levels)
+{
+  if (_channelStates == NULL) {
+    return 0;
+  }
+
+  #ifdef ESP_PLATFORM
+    levels->momentary = _momentary;
+    levels->shortTerm = _shortTerm;
+    _available = 0;
+
+    levels->integrated = integratedLoudness(_momentaryHistogram);
+    levels->loudnessRange = loudnessRange(_shortTermHistogram);
+  #else
+    // the I2S interrupt writes the block results and can add to or halve a histogram,
+    // so each histogram is gated on a copy taken with the interrupts masked
+    uint16_t histogram[HISTOGRAM_BINS];
+
+    noInterrupts();
+    levels->momentary = _momentary;
+    levels->shortTerm = _shortTerm;
+    _available = 0;
+    memcpy(histogram, _momentaryHistogram, sizeof(histogram));
+    interrupts();
+
+    levels->integrated = integratedLoudness(histogram);
+
+    noInterrupts();
+    memcpy(histogram, _shortTermHistogram, sizeof(histogram));
+    interrupts();
+
+    levels->loudnessRange = loudnessRange(histogram);
+  #endif
+
+  return 1;
+}
+
+void LoudnessAnalyzer::resetIntegration()
+{
+  if (_momentaryHistogram == NULL) {
+    return;
+  }
+
+  #ifndef ESP_PLATFORM
+    noInterrupts();
+  #endif
+  memset(_momentaryHistogram, 0x00, HISTOGRAM_BINS * sizeof(uint16_t));
+  memset(_shortTermHistogram, 0x00, HISTOGRAM_BINS * sizeof(uint16_t));
+  #ifndef ESP_PLATFORM
+    interrupts();
+  #endif
+}
+
+size_t LoudnessAnalyzer::memoryUsage()
+{
+  return _memoryUsage;
+}
+
+/*
+ * The K-weighting filters of BS.1770 for any sample rate, from their analog prototypes
+ * through the bilinear transform; at 48 kHz they are the coefficients listed in BS.1770:
+ *   shelf      b = 1.53512486, -2.69169619, 1.19839281   a = -1.69065929, 0.73248077
+ *   high-pass  b = 1, -2, 1                              a = -1.99004745, 0.99007225
+ */
+int LoudnessAnalyzer::configure(AudioIn* input)
+{
+  int bitsPerSample = input->bitsPerSample();
+  int channels = input->channels();
+  long sampleRate = input->sampleRate();
+
+  if (bitsPerSample != 16 && bitsPerSample != 32) {
+    return 0;
+  }
+
+  if (channels != 1 && channels != 2) {
+    return 0;
+  }
+
+  if (sampleRate < 8000) {
+    return 0;
+  }
+
+  freeBuffers();
+
+  _channelStates = (Channel*)calloc(channels, sizeof(Channel));
+  _momentaryHistogram = (uint16_t*)calloc(HISTOGRAM_BINS, sizeof(uint16_t));
+  _shortTermHistogram = (uint16_t*)calloc(HISTOGRAM_BINS, sizeof(uint16_t));
+
+  if (_channelStates == NULL || _momentaryHistogram == NULL || _shortTermHistogram == NULL) {
+    freeBuffers();
+
+    return 0;
+  }
+
+  double k = tan(M_PI * 1681.974450955533 / sampleRate);
+  double q = 0.7071752369554196;
+  double vh = pow(10.0, 3.999843853973347 / 20.0);
+  double vb = pow(vh, 0.4996667741545416);
+  double a0 = 1.0 + k / q + k * k;
+  double shelf[5] = {
+    (vh + vb * k / q + k * k) / a0,
+    2.0 * (k * k - vh) / a0,
+    (vh - vb * k / q + k * k) / a0,
+    2.0 * (k * k - 1.0) / a0,
+    (1.0 - k / q + k * k) / a0
+  };
+
+  k = tan(M_PI * 38.13547087602444 / sampleRate);
+  q = 0.5003270373238773;
+  a0 = 1.0 + k / q + k * k;
+
+  double highPass[2] = {
+    2.0 * (k * k - 1.0) / a0,
+    (1.0 - k / q + k * k) / a0
+  };
+
+  #ifdef ESP_PLATFORM
+    for (int i = 0; i < 3; i++) {
+      _shelfB[i] = (float)shelf[i];
+    }
+    for (int i = 0; i < 2; i++) {
+      _shelfA[i] = (float)shelf[3 + i];
+      _highPassA[i] = (float)highPass[i];
+    }
+  #else
+    for (int i = 0; i < 3; i++) {
+      _shelfB[i] = (int32_t)lround(shelf[i] * 268435456.0);
+    }
+    for (int i = 0; i < 2; i++) {
+      _shelfA[i] = (int32_t)lround(shelf[3 + i] * 268435456.0);
+      _highPassA[i] = (int32_t)lround(highPass[i] * 268435456.0);
+    }
+  #endif
+
+  _bitsPerSample = bitsPerSample;
+  _channels = channels;
+  _blockSize = sampleRate / 10;
+  _blockFrames = 0;
+  _blockIndex = 0;
+  _blocks = 0;
+  _momentary = -INFINITY;
+  _shortTerm = -INFINITY;
+  _available = 0;
+  _memoryUsage = channels * sizeof(Channel) + 2 * HISTOGRAM_BINS * sizeof(uint16_t);
+
+  return 1;
+}
+
+/*
+ * Every sample of every channel goes through the shelf and the high-pass, and the square of
+ * the result is added to the energy of its channel; every 100 ms the block is closed.
+ */
+void LoudnessAnalyzer::update(const void* buffer, size_t size)
+{
+  if (_channelStates == NULL) {
+    return;
+  }
+
+  int frames = size / (_bitsPerSample / 8) / _channels;
+
+  for (int i = 0; i < frames; i++) {
+    for (int c = 0; c < _channels; c++) {
+      Channel* channel = &_channelStates[c];
+
+      #ifdef ESP_PLATFORM
+        float x;
+
+        if (_bitsPerSample == 16) {
+          x = ((const int16_t*)buffer)[i * _channels + c] * (1.0f / 32768.0f);
+        } else {
+          x = ((const int32_t*)buffer)[i * _channels + c] * (1.0f / 2147483648.0f);
+        }
+
+        // transposed direct form II
+        float y = _shelfB[0] * x + channel->shelf[0];
+
+        channel->shelf[0] = _shelfB[1] * x - _shelfA[0] * y + channel->shelf[1];
+        channel->shelf[1] = _shelfB[2] * x - _shelfA[1] * y;
+
+        float z = y + channel->highPass[0];
+
+        channel->highPass[0] = -2.0f * y - _highPassA[0] * z + channel->highPass[1];
+        channel->highPass[1] = y - _highPassA[1] * z;
+
+        channel->energy += z * z;
+      #else
+        int32_t x;
+
+        // full scale is 2^26, the headroom covers the shelf gain and overshoots
+        if (_bitsPerSample == 16) {
+          x = (int32_t)((const int16_t*)buffer)[i * _channels + c] << 11;
+        } else {
+          x = ((const int32_t*)buffer)[i * _channels + c] >> 5;
+        }
+
+        // direct form I with Q28 coefficients
+        int64_t acc = (int64_t)_shelfB[0] * x + (int64_t)_shelfB[1] * channel->x[0] + (int64_t)_shelfB[2] * channel->x[1]
+                    - (int64_t)_shelfA[0] * channel->shelf[0] - (int64_t)_shelfA[1] * channel->shelf[1];
+        int32_t y = (int32_t)(acc >> 28);
+
+        acc = (((int64_t)y - 2 * (int64_t)channel->shelf[0] + channel->shelf[1]) << 28)
+            - (int64_t)_highPassA[0] * channel->highPass[0] - (int64_t)_highPassA[1] * channel->highPass[1];
+
+        int32_t z = (int32_t)(acc >> 28);
+
+        channel->x[1] = channel->x[0];
+        channel->x[0] = x;
+        channel->shelf[1] = channel->shelf[0];
+        channel->shelf[0] = y;
+        channel->highPass[1] = channel->highPass[0];
+        channel->highPass[0] = z;
+
+        // Q19 squares stay below 2^42, far from overflowing over a block
+        int64_t reduced = z >> 7;
+
+        channel->energy += (uint64_t)(reduced * reduced);
+      #endif
+    }
+
+    if (++_blockFrames == _blockSize) {
+      finishBlock();
+    }
+  }
+}
+
+/*
+ * 1. The block energy is the sum over the channels of their mean square, all weighted 1
+ * 2. The momentary and short-term loudness are the mean energy of the last 4 and 30 blocks
+ * 3. Both go into their histogram, which applies the absolute gate
+ */
+void LoudnessAnalyzer::finishBlock()
+{
+  float energy = 0.0f;
+
+  for (int c = 0; c < _channels; c++) {
+    #ifdef ESP_PLATFORM
+      energy += _channelStates[c].energy / _blockSize;
+      _channelStates[c].energy = 0.0f;
+    #else
+      // Q19 squares are 2^38 at full scale
+      energy += (float)((double)_channelStates[c].energy * (1.0 / 274877906944.0) / _blockSize);
+      _channelStates[c].energy = 0;
+    #endif
+  }
+
+  _blockEnergies[_blockIndex] = energy;
+  _blockFrames = 0;
+
+  if (++_blockIndex == RING_BLOCKS) {
+    _blockIndex = 0;
+  }
+
+  if (_blocks < RING_BLOCKS) {
+    _blocks++;
+  }
+
+  if (_blocks >= 4) {
+    float sum = 0.0f;
+
+    for (int i = 1; i <= 4; i++) {
+      sum += _blockEnergies[(_blockIndex + RING_BLOCKS - i) % RING_BLOCKS];
+    }
+
+    _momentary = energy_to_loudness(sum / 4.0f);
+    add_to_histogram(_momentaryHistogram, _momentary);
+  }
+
+  if (_blocks == RING_BLOCKS) {
+    float sum = 0.0f;
+
+    for (int i = 0; i < RING_BLOCKS; i++) {
+      sum += _blockEnergies[i];
+    }
+
+    _shortTerm = energy_to_loudness(sum / RING_BLOCKS);
+    add_to_histogram(_shortTermHistogram, _shortTerm);
+  }
+
+  if (_available < 0x7fff) {
+    _available++;
+  }
+}
+
+// BS.1770: mean energy of the 400 ms blocks above -70 LUFS and above their mean - 10 LU
+float LoudnessAnalyzer::integratedLoudness(const uint16_t* histogram)
+{
+  uint32_t count;
+  float energy = histogram_energy(histogram, 0, &count);
+
+  if (count == 0) {
+    return -INFINITY;
+  }
+
+  int from = histogram_bin(energy_to_loudness(energy) - 10.0f);
+
+  energy = histogram_energy(histogram, from, &count);
+
+  return count ? energy_to_loudness(energy) : -INFINITY;
+}
+
+// EBU Tech 3342: 95th - 10th percentile of the 3 s blocks above -70 LUFS and above their mean - 20 LU
+float LoudnessAnalyzer::loudnessRange(const uint16_t* histogram)
+{
+  uint32_t count;
+  float energy = histogram_energy(histogram, 0, &count);
+
+  if (count == 0) {
+    return 0.0f;
+  }
+
+  int from = histogram_bin(energy_to_loudness(energy) - 20.0f);
+  uint32_t total = 0;
+
+  for (int i = from; i < HISTOGRAM_BINS; i++) {
+    total += histogram[i];
+  }
+
+  if (total == 0) {
+    return 0.0f;
+  }
+
+  uint32_t lowCount = (uint32_t)(0.10f * total);
+  uint32_t highCount = (uint32_t)(0.95f * total);
+  uint32_t cumulative = 0;
+  int low = -1;
+  int high = -1;
+
+  for (int i = from; i < HISTOGRAM_BINS && high < 0; i++) {
+    cumulative += histogram[i];
+
+    if (low < 0 && cumulative > lowCount) {
+      low = i;
+    }
+    if (cumulative > highCount) {
+      high = i;
+    }
+  }
+
+  if (high < 0) {
+    high = HISTOGRAM_BINS - 1;
+  }
+
+  return 0.1f * (high - low);
+}
+
+void LoudnessAnalyzer::freeBuffers()
+{
+  if (_channelStates) {
+    free(_channelStates);
+    _channelStates = NULL;
+  }
+
+  if (_momentaryHistogram) {
+    free(_momentaryHistogram);
+    _momentaryHistogram = NULL;
+  }
+
+  if (_shortTermHistogram) {
+    free(_shortTermHistogram);
+    _shortTermHistogram = NULL;
+  }
+
+  _memoryUsage = 0;
+}
@@ -0,0 +1,110 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef _LOUDNESS_ANALYZER_H_INCLUDED
+#define _LOUDNESS_ANALYZER_H_INCLUDED
+
+#include <Arduino.h>
+
+#include "AudioAnalyzer.h"
+
+struct LoudnessLevels {
+  float momentary; // LUFS over the last 400 ms, -INFINITY until 400 ms have been seen
+  float shortTerm; // LUFS over the last 3 s, -INFINITY until 3 s have been seen
+  float integrated; // gated LUFS since configure or resetIntegration(), -INFINITY before any block passes the gates
+  float loudnessRange; // LU between the 10th and 95th percentiles of the gated short-term loudness
+};
+
+/*
+ * ITU-R BS.1770 / EBU R128 loudness. Each channel goes through the two
+ * K-weighting biquads, a high shelf and the RLB high-pass, and its weighted
+ * energy is summed over 100 ms blocks. The last 30 block energies give the
+ * momentary (4 blocks) and short-term (30 blocks) loudness every 100 ms.
+ *
+ * The integrated loudness and the loudness range (EBU Tech 3342) keep their
+ * gated values as counts in 0.1 LU histograms from -70 to +5 LUFS instead of
+ * a history, so the memory is fixed whatever the programme length; a count
+ * that would overflow halves its whole histogram.
+ *
+ * On ESP32 the filters run in float, on SAMD in fixed point.
+ */
+class LoudnessAnalyzer : public AudioAnalyzer
+{
+public:
+  LoudnessAnalyzer();
+  virtual ~LoudnessAnalyzer();
+
+  int available(); // number of 100 ms blocks completed since the last read
+  int read(LoudnessLevels* levels);
+  void resetIntegration(); // restart the integrated loudness and the loudness range
+
+  size_t memoryUsage(); // bytes of the filter states and histograms after configure
+
+protected:
+  virtual int configure(AudioIn* input);
+  virtual void update(const void* buffer, size_t size);
+
+private:
+  struct Channel {
+    #ifdef ESP_PLATFORM
+      float shelf[2]; // transposed direct form II states
+      float highPass[2];
+      float energy;
+    #else
+      int32_t x[2]; // direct form I history, Q26 samples
+      int32_t shelf[2];
+      int32_t highPass[2];
+      uint64_t energy; // squares of the outputs in Q19
+    #endif
+  };
+
+  void finishBlock();
+  float integratedLoudness(const uint16_t* histogram);
+  float loudnessRange(const uint16_t* histogram);
+  void freeBuffers();
+
+private:
+  int _bitsPerSample;
+  int _channels;
+  int _available;
+  int _blockSize; // frames of a 100 ms block
+  int _blockFrames;
+
+  Channel* _channelStates;
+  float _blockEnergies[30]; // ring of the mean square K-weighted energies of the last blocks
+  int _blockIndex;
+  int _blocks; // blocks in the ring, up to 30
+  float _momentary;
+  float _shortTerm;
+  uint16_t* _momentaryHistogram; // gated 400 ms blocks, for the integrated loudness
+  uint16_t* _shortTermHistogram; // gated 3 s blocks, for the loudness range
+  size_t _memoryUsage;
+
+  #ifdef ESP_PLATFORM
+    float _shelfB[3];
+    float _shelfA[2];
+    float _highPassA[2]; // the high-pass numerator is 1, -2, 1
+    uint8_t _data_buffer[256];
+  #else
+    int32_t _shelfB[3]; // Q28
+    int32_t _shelfA[2];
+    int32_t _highPassA[2];
+  #endif
+};
+
+#endif
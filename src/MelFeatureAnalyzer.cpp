@@ -0,0 +1,238 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "AudioIn.h"
+
+#include "MelFeatureAnalyzer.h"
+
+static float hz_to_mel(float frequency)
+{
+  return 2595.0f * log10f(1.0f + frequency / 700.0f);
+}
+
+static float mel_to_hz(float mel)
+{
+  return 700.0f * (powf(10.0f, mel / 2595.0f) - 1.0f);
+}
+
+MelFeatureAnalyzer::MelFeatureAnalyzer(int length, int bands, int coefficients) :
+  FFTBandAnalyzer(length),
+  _length(length),
+  _bands(bands),
+  _coefficients(coefficients),
+  _lowFrequency(0.0f),
+  _highFrequency(0.0f),
+  _output(MEL_OUTPUT_ENERGY),
+  _energies(NULL),
+  _dctBuffer(NULL),
+  _filterbankMemoryUsage(0)
+{
+}
+
+MelFeatureAnalyzer::~MelFeatureAnalyzer()
+{
+  detach();
+  freeFilterbank();
+}
+
+void MelFeatureAnalyzer::setFrequencyRange(float low, float high)
+{
+  _lowFrequency = low;
+  _highFrequency = high;
+}
+
+void MelFeatureAnalyzer::setOutput(MelOutput output)
+{
+  _output = output;
+}
+
+int MelFeatureAnalyzer::read(float features[], int size)
+{
+  return readValues(features, size, (_output == MEL_OUTPUT_MFCC) ? _coefficients : _bands);
+}
+
+size_t MelFeatureAnalyzer::memoryUsage()
+{
+  return FFTBandAnalyzer::memoryUsage() + _filterbankMemoryUsage;
+}
+
+int MelFeatureAnalyzer::configure(AudioIn* input)
+{
+  long sampleRate = input->sampleRate();
+  float high = (_highFrequency > 0.0f) ? _highFrequency : sampleRate / 2.0f;
+
+  if (_bands <= 0 || _coefficients < 0 || _coefficients > _bands) {
+    return 0;
+  }
+
+  // the filterbank spans the length / 2 + 1 bins of a real transform
+  if (zoomed()) {
+    return 0;
+  }
+
+  if (sampleRate <= 0 || _lowFrequency < 0.0f || high <= _lowFrequency || high > sampleRate / 2.0f) {
+    return 0;
+  }
+
+  // the filterbank weights the power spectrum
+  FFTAnalyzer::setOutput(FFT_OUTPUT_POWER);
+
+  if (!FFTAnalyzer::configure(input)) {
+    return 0;
+  }
+
+  freeFilterbank();
+
+  // band m rises from point m to point m + 1 and falls to point m + 2,
+  // the points are equally spaced on the mel scale
+  float lowMel = hz_to_mel(_lowFrequency);
+  float melStep = (hz_to_mel(high) - lowMel) / (_bands + 1);
+  float binWidth = (float)sampleRate / _length;
+  int lastBin = _length / 2;
+
+  // the features are bands values, or the first coefficients of them
+  if (!buildBands(_bands, _bands)) {
+    return 0;
+  }
+
+  for (int m = 0; m < _bands; m++) {
+    float lower = mel_to_hz(lowMel + m * melStep);
+    float upper = mel_to_hz(lowMel + (m + 2) * melStep);
+    int first = (int)ceilf(lower / binWidth);
+    int last = (int)floorf(upper / binWidth);
+
+    // the triangle is zero on its edges
+    if (first * binWidth <= lower) {
+      first++;
+    }
+    if (last * binWidth >= upper) {
+      last--;
+    }
+    if (last > lastBin) {
+      last = lastBin;
+    }
+
+    setBandBins(m, first, last);
+  }
+
+  if (!buildWeights()) {
+    return 0;
+  }
+
+  _energies = (float*)calloc(_bands, sizeof(float));
+  if (_coefficients > 0) {
+    _dctBuffer = (float*)calloc(_coefficients * _bands, sizeof(float));
+  }
+
+  if (_energies == NULL || (_coefficients > 0 && _dctBuffer == NULL)) {
+    freeFilterbank();
+
+    return 0;
+  }
+
+  for (int m = 0; m < _bands; m++) {
+    float lower = mel_to_hz(lowMel + m * melStep);
+    float center = mel_to_hz(lowMel + (m + 1) * melStep);
+    float upper = mel_to_hz(lowMel + (m + 2) * melStep);
+    float* weight = bandWeights(m);
+
+    for (int i = 0; i < bandBins(m); i++) {
+      float frequency = (bandFirstBin(m) + i) * binWidth;
+
+      if (frequency <= center) {
+        weight[i] = (frequency - lower) / (center - lower);
+      } else {
+        weight[i] = (upper - frequency) / (upper - center);
+      }
+    }
+  }
+
+  // orthonormal DCT-II: sqrt(2 / M) * cos(pi * k * (m + 0.5) / M), k = 0 scaled by 1 / sqrt(2)
+  for (int k = 0; k < _coefficients; k++) {
+    float scale = sqrtf((k == 0 ? 1.0f : 2.0f) / _bands);
+
+    for (int m = 0; m < _bands; m++) {
+      _dctBuffer[k * _bands + m] = scale * cosf(PI * k * (m + 0.5f) / _bands);
+    }
+  }
+
+  _filterbankMemoryUsage = (_bands + _coefficients * _bands) * sizeof(float);
+
+  return 1;
+}
+
+/*
+ * 1. Weight the power spectrum with the non-zero part of each mel triangle
+ * 2. MEL_OUTPUT_LOG_ENERGY and MEL_OUTPUT_MFCC: take the natural log of the band powers
+ * 3. MEL_OUTPUT_MFCC: project the log powers on the DCT-II rows
+ */
+void MelFeatureAnalyzer::spectrumComputed()
+{
+  float* features = values();
+
+  if (features == NULL || _energies == NULL) {
+    return;
+  }
+
+  for (int m = 0; m < _bands; m++) {
+    _energies[m] = bandPower(m);
+  }
+
+  if (_output == MEL_OUTPUT_ENERGY) {
+    memcpy(features, _energies, sizeof(float) * _bands);
+  } else {
+    for (int m = 0; m < _bands; m++) {
+      // keep silent bands finite
+      _energies[m] = logf(_energies[m] > 1e-10f ? _energies[m] : 1e-10f);
+    }
+
+    if (_output == MEL_OUTPUT_LOG_ENERGY) {
+      memcpy(features, _energies, sizeof(float) * _bands);
+    } else {
+      for (int k = 0; k < _coefficients; k++) {
+        const float* row = &_dctBuffer[k * _bands];
+        float sum = 0.0f;
+
+        for (int m = 0; m < _bands; m++) {
+          sum += row[m] * _energies[m];
+        }
+
+        features[k] = sum;
+      }
+    }
+  }
+
+  valuesComputed();
+}
+
+void MelFeatureAnalyzer::freeFilterbank()
+{
+  freeBands();
+
+  if (_energies) {
+    free(_energies);
+    _energies = NULL;
+  }
+
+  if (_dctBuffer) {
+    free(_dctBuffer);
+    _dctBuffer = NULL;
+  }
+
+  _filterbankMemoryUsage = 0;
+}
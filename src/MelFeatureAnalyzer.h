@@ -0,0 +1,78 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef _MEL_FEATURE_ANALYZER_H_INCLUDED
+#define _MEL_FEATURE_ANALYZER_H_INCLUDED
+
+#include <Arduino.h>
+
+#include "FFTBandAnalyzer.h"
+
+enum MelOutput {
+  MEL_OUTPUT_ENERGY = 0, // power in each mel band, the default
+  MEL_OUTPUT_LOG_ENERGY, // ln of the band power
+  MEL_OUTPUT_MFCC // orthonormal DCT-II of the log band powers
+};
+
+/*
+ * Mel band features of every FFTAnalyzer spectrum. The power spectrum goes
+ * through a triangular mel filterbank (HTK mel scale) stored as its non-zero
+ * weights only, then optionally a log and a DCT-II for MFCCs, so each hop
+ * yields bands or coefficients values instead of length / 2 + 1 bins.
+ *
+ * The hop size, overlap and window are set as on FFTAnalyzer. setZoom() is
+ * not supported, input() fails when it is on.
+ */
+class MelFeatureAnalyzer : public FFTBandAnalyzer
+{
+public:
+  // coefficients is the number of MFCCs kept by MEL_OUTPUT_MFCC
+  MelFeatureAnalyzer(int length, int bands, int coefficients = 13);
+  virtual ~MelFeatureAnalyzer();
+
+  // band edges of the filterbank, the default high frequency 0 means sampleRate / 2
+  void setFrequencyRange(float low, float high);
+  void setOutput(MelOutput output);
+
+  // available() counts the feature vectors computed since the last read, only the newest is kept
+  // copies at most bands values, or coefficients values for MEL_OUTPUT_MFCC
+  int read(float features[], int size);
+
+  size_t memoryUsage(); // bytes of the FFT buffers plus the filterbank
+
+protected:
+  virtual int configure(AudioIn* input);
+  virtual void spectrumComputed();
+
+private:
+  void freeFilterbank();
+
+private:
+  int _length;
+  int _bands;
+  int _coefficients;
+  float _lowFrequency;
+  float _highFrequency;
+  MelOutput _output;
+
+  float* _energies; // band powers of the newest spectrum
+  float* _dctBuffer; // coefficients x bands DCT-II matrix, MEL_OUTPUT_MFCC only
+  size_t _filterbankMemoryUsage; // _energies and _dctBuffer, the bands are counted by FFTBandAnalyzer
+};
+
+#endif
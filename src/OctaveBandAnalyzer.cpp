@@ -0,0 +1,209 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "AudioIn.h"
+
+#include "OctaveBandAnalyzer.h"
+
+// midband frequency of band x of the base 10 series, b bands per octave
+static float midband_frequency(int x, int b)
+{
+  return 1000.0f * powf(10.0f, 0.3f * x / b);
+}
+
+// ratio between the upper edge and the midband frequency of a band
+static float edge_ratio(int b)
+{
+  return powf(10.0f, 0.15f / b);
+}
+
+OctaveBandAnalyzer::OctaveBandAnalyzer(int length, int bandsPerOctave) :
+  FFTBandAnalyzer(length),
+  _length(length),
+  _bandsPerOctave(bandsPerOctave),
+  _lowFrequency(0.0f),
+  _highFrequency(0.0f),
+  _output(FFT_OUTPUT_DB),
+  _firstIndex(0)
+{
+  setWindow(FFT_WINDOW_HANN);
+}
+
+OctaveBandAnalyzer::~OctaveBandAnalyzer()
+{
+  detach();
+}
+
+void OctaveBandAnalyzer::setFrequencyRange(float low, float high)
+{
+  _lowFrequency = low;
+  _highFrequency = high;
+}
+
+void OctaveBandAnalyzer::setOutput(FFTOutput output)
+{
+  _output = output;
+}
+
+int OctaveBandAnalyzer::bands()
+{
+  return bandCount();
+}
+
+float OctaveBandAnalyzer::bandFrequency(int band)
+{
+  if (band < 0 || band >= bandCount()) {
+    return 0.0f;
+  }
+
+  return midband_frequency(_firstIndex + band, _bandsPerOctave);
+}
+
+int OctaveBandAnalyzer::read(float levels[], int size)
+{
+  return readValues(levels, size, bandCount());
+}
+
+int OctaveBandAnalyzer::configure(AudioIn* input)
+{
+  long sampleRate = input->sampleRate();
+  float nyquist = sampleRate / 2.0f;
+  float high = (_highFrequency > 0.0f) ? _highFrequency : nyquist;
+
+  if (_bandsPerOctave != 1 && _bandsPerOctave != 3) {
+    return 0;
+  }
+
+  // the bands span the length / 2 + 1 bins of a real transform
+  if (zoomed()) {
+    return 0;
+  }
+
+  if (sampleRate <= 0 || _lowFrequency < 0.0f || high <= _lowFrequency) {
+    return 0;
+  }
+
+  float binWidth = (float)sampleRate / _length;
+  float edge = edge_ratio(_bandsPerOctave);
+  // the nominal frequencies, 31.5 Hz for 31.62 Hz, are within a quarter band of the exact ones
+  float tolerance = sqrtf(edge);
+  float scale = 10.0f * _bandsPerOctave / 3.0f;
+  int first;
+
+  if (_lowFrequency > 0.0f) {
+    first = (int)ceilf(scale * log10f(_lowFrequency / tolerance / 1000.0f));
+  } else {
+    // the width of a band is fm * (edge - 1 / edge)
+    first = (int)ceilf(scale * log10f(binWidth / (edge - 1.0f / edge) / 1000.0f));
+  }
+
+  int last = (int)floorf(scale * log10f(high * tolerance / 1000.0f));
+
+  // the upper edge of the last band stays below Nyquist
+  while (last >= first && midband_frequency(last, _bandsPerOctave) * edge > nyquist * 1.0001f) {
+    last--;
+  }
+
+  if (last < first) {
+    return 0;
+  }
+
+  // the bands sum the power spectrum
+  FFTAnalyzer::setOutput(FFT_OUTPUT_POWER);
+
+  if (!FFTAnalyzer::configure(input)) {
+    return 0;
+  }
+
+  int bands = last - first + 1;
+
+  // one level per band
+  if (!buildBands(bands, bands)) {
+    return 0;
+  }
+
+  _firstIndex = first;
+
+  // bin k stands for [k - 0.5, k + 0.5] bin widths, DC and Nyquist for half of that
+  int lastBin = _length / 2;
+
+  for (int m = 0; m < bands; m++) {
+    float midband = midband_frequency(first + m, _bandsPerOctave);
+    int firstBin = (int)floorf(midband / edge / binWidth + 0.5f);
+    int bandLastBin = (int)floorf(midband * edge / binWidth + 0.5f);
+
+    if (bandLastBin > lastBin) {
+      bandLastBin = lastBin;
+    }
+
+    setBandBins(m, firstBin, bandLastBin);
+  }
+
+  if (!buildWeights()) {
+    return 0;
+  }
+
+  for (int m = 0; m < bands; m++) {
+    float midband = midband_frequency(first + m, _bandsPerOctave);
+    float lower = midband / edge;
+    float upper = midband * edge;
+    float* weight = bandWeights(m);
+
+    for (int i = 0; i < bandBins(m); i++) {
+      int bin = bandFirstBin(m) + i;
+      float from = (bin - 0.5f) * binWidth;
+      float to = (bin + 0.5f) * binWidth;
+
+      if (from < lower) {
+        from = lower;
+      }
+      if (to > upper) {
+        to = upper;
+      }
+
+      // adjacent bands share their edge bins, the weights of a bin add up to 1
+      weight[i] = (to > from) ? (to - from) / binWidth : 0.0f;
+    }
+  }
+
+  return 1;
+}
+
+void OctaveBandAnalyzer::spectrumComputed()
+{
+  float* levels = values();
+
+  if (levels == NULL) {
+    return;
+  }
+
+  for (int m = 0; m < bandCount(); m++) {
+    float power = bandPower(m);
+
+    if (_output == FFT_OUTPUT_DB) {
+      // keep silent bands finite
+      levels[m] = 10.0f * log10f(power > 1e-10f ? power : 1e-10f);
+    } else if (_output == FFT_OUTPUT_MAGNITUDE) {
+      levels[m] = sqrtf(power);
+    } else {
+      levels[m] = power;
+    }
+  }
+
+  valuesComputed();
+}
@@ -0,0 +1,72 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef _OCTAVE_BAND_ANALYZER_H_INCLUDED
+#define _OCTAVE_BAND_ANALYZER_H_INCLUDED
+
+#include <Arduino.h>
+
+#include "FFTBandAnalyzer.h"
+
+/*
+ * 1/1 or 1/3 octave band levels of every FFTAnalyzer spectrum. The bands
+ * follow the base 10 series of IEC 61260: midband frequencies
+ * 1000 * 10^(3x / 10b) Hz and edges a factor 10^(3 / 20b) either side, for
+ * b = 1 or 3 bands per octave. Each band sums the power of the bins it
+ * covers, the bins on its edges weighted by the fraction inside the band,
+ * from a table built in configure(), so each hop yields about 30 values
+ * instead of length / 2 + 1 bins.
+ *
+ * Bands narrower than a bin (sampleRate / length) cannot be resolved, by
+ * default the lowest band is the first one at least a bin wide. The window
+ * defaults to Hann to keep the leakage between bands low, the hop size,
+ * overlap and window are set as on FFTAnalyzer. setZoom() is not supported,
+ * input() fails when it is on.
+ */
+class OctaveBandAnalyzer : public FFTBandAnalyzer
+{
+public:
+  // bandsPerOctave is 1 or 3
+  OctaveBandAnalyzer(int length, int bandsPerOctave = 3);
+  virtual ~OctaveBandAnalyzer();
+
+  // keep the bands with a midband frequency in [low, high], high 0 means up to sampleRate / 2
+  void setFrequencyRange(float low, float high);
+  // band power in the units of FFT_OUTPUT_POWER spectra, its square root, or dB (the default)
+  void setOutput(FFTOutput output);
+
+  int bands(); // number of bands, known after configure
+  float bandFrequency(int band); // exact midband frequency in Hz, band 0 is the lowest
+
+  // available() counts the band vectors computed since the last read, only the newest is kept
+  int read(float levels[], int size); // copies at most bands() values, lowest band first
+
+protected:
+  virtual int configure(AudioIn* input);
+  virtual void spectrumComputed();
+
+private:
+  int _length;
+  int _bandsPerOctave;
+  float _lowFrequency;
+  float _highFrequency;
+  FFTOutput _output;
+  int _firstIndex; // series index x of band 0
+};
+
+#endif
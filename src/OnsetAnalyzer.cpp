@@ -0,0 +1,234 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "AudioIn.h"
+
+#include "OnsetAnalyzer.h"
+
+#define ONSET_EVENTS (int)(sizeof(_events) / sizeof(_events[0]))
+#define ONSET_MAX_HISTORY 31
+
+OnsetAnalyzer::OnsetAnalyzer(int length, int history) :
+  FFTAnalyzer(length),
+  _length(length),
+  _history(history),
+  _multiplier(1.5f),
+  _offset(0.0f),
+  _previousSpectrum(NULL),
+  _fluxHistory(NULL),
+  _fluxIndex(0),
+  _fluxCount(0),
+  _above(0),
+  _stateMemoryUsage(0),
+  _eventIndex(0),
+  _eventCount(0)
+{
+  setHopSize(length / 4);
+}
+
+OnsetAnalyzer::~OnsetAnalyzer()
+{
+  detach();
+  freeState();
+}
+
+void OnsetAnalyzer::setThreshold(float multiplier, float offset)
+{
+  _multiplier = multiplier;
+  _offset = offset;
+}
+
+int OnsetAnalyzer::available()
+{
+  // pulls the input on ESP32
+  FFTAnalyzer::available();
+
+  return _eventCount;
+}
+
+int OnsetAnalyzer::read(OnsetEvent events[], int size)
+{
+  int count = 0;
+
+  #ifndef ESP_PLATFORM
+    noInterrupts();
+  #endif
+  while (count < size && _eventCount > 0) {
+    events[count++] = _events[_eventIndex];
+
+    _eventIndex = (_eventIndex + 1) % ONSET_EVENTS;
+    _eventCount--;
+  }
+  #ifndef ESP_PLATFORM
+    interrupts();
+  #endif
+
+  return count;
+}
+
+size_t OnsetAnalyzer::memoryUsage()
+{
+  return FFTAnalyzer::memoryUsage() + _stateMemoryUsage;
+}
+
+int OnsetAnalyzer::configure(AudioIn* input)
+{
+  if (_history < 1 || _history > ONSET_MAX_HISTORY) {
+    return 0;
+  }
+
+  // the flux is taken over the length / 2 + 1 bins of a real transform
+  if (zoomed()) {
+    return 0;
+  }
+
+  // the flux is taken on magnitudes
+  FFTAnalyzer::setOutput(FFT_OUTPUT_MAGNITUDE);
+
+  if (!FFTAnalyzer::configure(input)) {
+    return 0;
+  }
+
+  freeState();
+
+  int bins = _length / 2 + 1;
+
+  _previousSpectrum = (float*)calloc(bins, sizeof(float));
+  _fluxHistory = (float*)calloc(_history, sizeof(float));
+
+  if (_previousSpectrum == NULL || _fluxHistory == NULL) {
+    freeState();
+
+    return 0;
+  }
+
+  _stateMemoryUsage = (bins + _history) * sizeof(float);
+  _fluxIndex = 0;
+  // the first spectrum has no predecessor, it only fills _previousSpectrum
+  _fluxCount = -1;
+  _above = 0;
+  _eventIndex = 0;
+  _eventCount = 0;
+
+  return 1;
+}
+
+/*
+ * 1. Half-wave rectified flux against the previous spectrum, which is replaced on the way
+ * 2. Threshold from the median of the previous fluxes, the current one is not part of it
+ * 3. Report an onset when the flux goes over the threshold, it has to fall back under it
+ *    before the next one, and the oldest pending onset makes room when the queue is full
+ * 4. Push the flux into the history
+ */
+void OnsetAnalyzer::spectrumComputed()
+{
+  if (_previousSpectrum == NULL) {
+    return;
+  }
+
+  int bins = _length / 2 + 1;
+  float flux = 0.0f;
+
+  for (int k = 0; k < bins; k++) {
+    float magnitude = spectrumValue(k);
+    float rise = magnitude - _previousSpectrum[k];
+
+    if (rise > 0.0f) {
+      flux += rise;
+    }
+
+    _previousSpectrum[k] = magnitude;
+  }
+
+  if (_fluxCount < 0) {
+    _fluxCount = 0;
+
+    return;
+  }
+
+  if (_fluxCount > 0) {
+    float threshold = _multiplier * median() + _offset;
+
+    if (flux > threshold) {
+      if (!_above) {
+        int slot = (_eventIndex + _eventCount) % ONSET_EVENTS;
+
+        if (_eventCount == ONSET_EVENTS) {
+          _eventIndex = (_eventIndex + 1) % ONSET_EVENTS;
+        } else {
+          _eventCount++;
+        }
+
+        long rate = sampleRate();
+
+        _events[slot].frame = framePosition();
+        _events[slot].time = (rate > 0) ? (uint32_t)((uint64_t)framePosition() * 1000 / rate) : 0;
+        _events[slot].strength = (threshold > 0.0f) ? flux / threshold : flux;
+      }
+
+      _above = 1;
+    } else {
+      _above = 0;
+    }
+  }
+
+  _fluxHistory[_fluxIndex] = flux;
+  _fluxIndex = (_fluxIndex + 1) % _history;
+  if (_fluxCount < _history) {
+    _fluxCount++;
+  }
+}
+
+// median of the fluxes in the history, sorted by insertion on a copy
+float OnsetAnalyzer::median()
+{
+  float sorted[ONSET_MAX_HISTORY];
+
+  for (int i = 0; i < _fluxCount; i++) {
+    float value = _fluxHistory[i];
+    int j = i;
+
+    while (j > 0 && sorted[j - 1] > value) {
+      sorted[j] = sorted[j - 1];
+      j--;
+    }
+
+    sorted[j] = value;
+  }
+
+  if (_fluxCount & 1) {
+    return sorted[_fluxCount / 2];
+  }
+
+  return 0.5f * (sorted[_fluxCount / 2 - 1] + sorted[_fluxCount / 2]);
+}
+
+void OnsetAnalyzer::freeState()
+{
+  if (_previousSpectrum) {
+    free(_previousSpectrum);
+    _previousSpectrum = NULL;
+  }
+
+  if (_fluxHistory) {
+    free(_fluxHistory);
+    _fluxHistory = NULL;
+  }
+
+  _stateMemoryUsage = 0;
+}
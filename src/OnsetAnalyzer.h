@@ -0,0 +1,86 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef _ONSET_ANALYZER_H_INCLUDED
+#define _ONSET_ANALYZER_H_INCLUDED
+
+#include <Arduino.h>
+
+#include "FFTAnalyzer.h"
+
+struct OnsetEvent {
+  uint32_t frame; // input frames since input(), at the end of the window that detected the onset
+  uint32_t time; // the same position in milliseconds
+  float strength; // spectral flux over the threshold it crossed, above 1
+};
+
+/*
+ * Onsets (claps, knocks, note attacks) from the half-wave rectified spectral flux
+ *   flux[n] = sum(max(0, |X[n][k]| - |X[n-1][k]|))
+ * of consecutive FFTAnalyzer magnitude spectra. An onset is reported when the flux
+ * rises above multiplier * median(last history fluxes) + offset, so sustained noise
+ * raises its own threshold. Only the previous spectrum and the flux history are kept.
+ *
+ * The default hop is a quarter of the length, use setHopSize() for about 5 ms.
+ * setZoom() is not supported, input() fails when it is on.
+ */
+class OnsetAnalyzer : public FFTAnalyzer
+{
+public:
+  // history is the number of previous fluxes the median is taken over, up to 31
+  OnsetAnalyzer(int length, int history = 11);
+  virtual ~OnsetAnalyzer();
+
+  // threshold = multiplier * median + offset, offset is in spectrum magnitude units
+  void setThreshold(float multiplier, float offset);
+
+  int available(); // number of onsets waiting to be read, the newest 8 are kept
+  int read(OnsetEvent events[], int size);
+
+  size_t memoryUsage(); // bytes of the FFT buffers plus the flux state
+
+protected:
+  virtual int configure(AudioIn* input);
+  virtual void spectrumComputed();
+
+private:
+  // the flux is taken on magnitudes, configure() selects them
+  using FFTAnalyzer::setOutput;
+
+  float median();
+  void freeState();
+
+private:
+  int _length;
+  int _history;
+  float _multiplier;
+  float _offset;
+
+  float* _previousSpectrum;
+  float* _fluxHistory; // ring of the last _history fluxes
+  int _fluxIndex;
+  int _fluxCount; // fluxes in the ring, up to _history
+  int _above; // the flux was over the threshold on the previous spectrum
+  size_t _stateMemoryUsage;
+
+  OnsetEvent _events[8]; // ring of pending onsets
+  int _eventIndex; // oldest pending onset
+  int _eventCount;
+};
+
+#endif
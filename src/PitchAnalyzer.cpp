@@ -0,0 +1,484 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "AudioIn.h"
+
+#include "PitchAnalyzer.h"
+
+PitchAnalyzer::PitchAnalyzer(int length) :
+  _length(length),
+  _sampleRate(0),
+  _bitsPerSample(-1),
+  _channels(-1),
+  _hopSize(length),
+  _hopFrames(0),
+  _lowFrequency(0.0f),
+  _highFrequency(0.0f),
+  _threshold(0.15f),
+  _available(0),
+  _frequency(0.0f),
+  _confidence(0.0f),
+  _sampleBuffer(NULL),
+  _sampleIndex(0),
+  _windowBuffer(NULL),
+  _fftBuffer(NULL),
+  _memoryUsage(0)
+#ifdef ESP_PLATFORM
+  , _twiddleBuffer(NULL),
+  _data_buffer(NULL)
+#else
+  , _outputBuffer(NULL),
+  _pending(0)
+#endif
+{
+}
+
+PitchAnalyzer::~PitchAnalyzer()
+{
+  detach();
+  freeBuffers();
+}
+
+void PitchAnalyzer::setHopSize(int hopSize)
+{
+  if (hopSize < 1) {
+    hopSize = 1;
+  }
+
+  _hopSize = hopSize;
+  _hopFrames = 0;
+}
+
+void PitchAnalyzer::setFrequencyRange(float low, float high)
+{
+  _lowFrequency = low;
+  _highFrequency = high;
+}
+
+void PitchAnalyzer::setThreshold(float threshold)
+{
+  _threshold = threshold;
+}
+
+int PitchAnalyzer::available()
+{
+  #ifdef ESP_PLATFORM
+    if (_attachedInput == NULL) {
+      return 0;
+    }
+
+    if (_data_buffer) {
+      _attachedInput->read(_data_buffer, _length);
+    }
+  #else
+    if (_pending) {
+      // the soft float transforms are too slow for the I2S interrupt
+      estimate();
+      _pending = 0;
+
+      if (_available < 0x7fff) {
+        _available++;
+      }
+    }
+  #endif
+
+  return _available;
+}
+
+int PitchAnalyzer::read(float* frequency, float* confidence)
+{
+  if (!_available) {
+    return 0;
+  }
+
+  *frequency = _frequency;
+  if (confidence) {
+    *confidence = _confidence;
+  }
+
+  _available = 0;
+
+  return 1;
+}
+
+size_t PitchAnalyzer::memoryUsage()
+{
+  return _memoryUsage;
+}
+
+int PitchAnalyzer::configure(AudioIn* input)
+{
+  int bitsPerSample = input->bitsPerSample();
+  int channels = input->channels();
+
+  if (bitsPerSample != 16 && bitsPerSample != 32) {
+    return 0;
+  }
+
+  if (channels != 1 && channels != 2) {
+    return 0;
+  }
+
+  // the zero padded transform is twice the window
+  int fftLength = 2 * _length;
+
+  #ifdef ESP_PLATFORM
+    if (_length < 8 || (_length & (_length - 1))) {
+      return 0;
+    }
+  #else
+    if (ARM_MATH_SUCCESS != arm_rfft_fast_init_f32(&_S, fftLength)) {
+      return 0;
+    }
+  #endif
+
+  freeBuffers();
+
+  _sampleRate = input->sampleRate();
+  _bitsPerSample = bitsPerSample;
+  _channels = channels;
+  _sampleIndex = 0;
+  _hopFrames = 0;
+  _available = 0;
+
+  _sampleBuffer = (float*)calloc(_length, sizeof(float));
+  _windowBuffer = (float*)calloc(_length, sizeof(float));
+  #ifdef ESP_PLATFORM
+    // fftLength complex points and their twiddle table
+    _fftBuffer = (float*)calloc(2 * fftLength, sizeof(float));
+    _twiddleBuffer = (float*)calloc(fftLength, sizeof(float));
+    _data_buffer = (uint8_t*)calloc(_length, 1);
+  #else
+    // arm_rfft_fast_f32 modifies its input, so input and output are separate
+    _fftBuffer = (float*)calloc(fftLength, sizeof(float));
+    _outputBuffer = (float*)calloc(fftLength, sizeof(float));
+  #endif
+
+  if (_sampleBuffer == NULL || _windowBuffer == NULL || _fftBuffer == NULL
+  #ifdef ESP_PLATFORM
+      || _twiddleBuffer == NULL || _data_buffer == NULL
+  #else
+      || _outputBuffer == NULL
+  #endif
+  ) {
+    freeBuffers();
+
+    return 0;
+  }
+
+  #ifdef ESP_PLATFORM
+    _memoryUsage = (2 * _length + 3 * fftLength) * sizeof(float) + _length;
+
+    // private twiddle table, so analyzers of different lengths can coexist
+    dsps_gen_w_r2_fc32(_twiddleBuffer, fftLength);
+    dsps_bit_rev_fc32_ansi(_twiddleBuffer, fftLength >> 1);
+  #else
+    _memoryUsage = (2 * _length + 2 * fftLength) * sizeof(float);
+    _pending = 0;
+  #endif
+
+  return 1;
+}
+
+/*
+ * 1. Recompute sample size - we only take number of frames disregarding number of channels
+ * 2. Split the block at hop boundaries, frames that can not reach the next estimate are skipped
+ * 3. Estimate the pitch every time a full hop has been written, on SAMD hand the window
+ *    to available() instead
+ */
+void PitchAnalyzer::update(const void* buffer, size_t size)
+{
+  int frameSize = (_bitsPerSample / 8) * _channels;
+  int frames = size / frameSize;
+  const uint8_t* src = (const uint8_t*)buffer;
+
+  while (frames > 0) {
+    int chunk = _hopSize - _hopFrames;
+    if (chunk > frames) {
+      chunk = frames;
+    }
+
+    // only the last _length frames of a hop end up in the estimate
+    int skip = (_hopSize - _length) - _hopFrames;
+    if (skip > chunk) {
+      skip = chunk;
+    }
+    if (skip < 0) {
+      skip = 0;
+    }
+
+    writeHistory(src + skip * frameSize, chunk - skip);
+
+    src += chunk * frameSize;
+    frames -= chunk;
+    _hopFrames += chunk;
+
+    if (_hopFrames == _hopSize) {
+      _hopFrames = 0;
+
+      #ifdef ESP_PLATFORM
+        snapshot();
+        estimate();
+
+        if (_available < 0x7fff) {
+          _available++;
+        }
+      #else
+        // available() still reads the previous window, this hop is skipped
+        if (!_pending) {
+          snapshot();
+          _pending = 1;
+        }
+      #endif
+    }
+  }
+}
+
+// append frames to the circular history as mono float samples
+void PitchAnalyzer::writeHistory(const uint8_t* buffer, int frames)
+{
+  for (int i = 0; i < frames; i++) {
+    float sample;
+
+    if (_bitsPerSample == 16) {
+      const int16_t* src = (const int16_t*)buffer + i * _channels;
+
+      sample = (_channels == 2) ? 0.5f * ((float)src[0] + (float)src[1]) : (float)src[0];
+    } else {
+      const int32_t* src = (const int32_t*)buffer + i * _channels;
+
+      sample = (_channels == 2) ? 0.5f * ((float)src[0] + (float)src[1]) : (float)src[0];
+    }
+
+    _sampleBuffer[_sampleIndex] = sample;
+
+    if (++_sampleIndex == _length) {
+      _sampleIndex = 0;
+    }
+  }
+}
+
+// copy the circular history to _windowBuffer, oldest sample first
+void PitchAnalyzer::snapshot()
+{
+  int tail = _length - _sampleIndex;
+
+  memcpy(_windowBuffer, _sampleBuffer + _sampleIndex, tail * sizeof(float));
+  memcpy(_windowBuffer + tail, _sampleBuffer, _sampleIndex * sizeof(float));
+}
+
+/*
+ * Linear autocorrelation r(tau) = sum(x[j] * x[j + tau]) of _windowBuffer,
+ * into _fftBuffer[0 .. _length / 2]:
+ * 1. Zero pad the _length samples to 2 * _length, so the circular correlation does not wrap
+ * 2. Forward FFT, then the power |X[k]|^2 of every bin
+ * 3. Inverse FFT of the power; it is real and even, so on ESP32 a second forward FFT
+ *    divided by the FFT length does the same
+ */
+void PitchAnalyzer::autocorrelation()
+{
+  int fftLength = 2 * _length;
+
+  #ifdef ESP_PLATFORM
+    float* buffer = _fftBuffer;
+    int maxLag = _length / 2;
+
+    for (int j = 0; j < _length; j++) {
+      buffer[2 * j] = _windowBuffer[j];
+      buffer[2 * j + 1] = 0.0f;
+    }
+    memset(buffer + 2 * _length, 0, 2 * _length * sizeof(float));
+
+    for (int pass = 0; pass < 2; pass++) {
+      #if defined ESP32
+        dsps_fft2r_fc32_ae32_(buffer, fftLength, _twiddleBuffer);
+      #elif defined ESP32S2
+        dsps_fft2r_fc32_ansi_(buffer, fftLength, _twiddleBuffer);
+      #endif
+      dsps_bit_rev_fc32_ansi(buffer, fftLength);
+
+      if (pass == 0) {
+        for (int k = 0; k < fftLength; k++) {
+          float re = buffer[2 * k];
+          float im = buffer[2 * k + 1];
+
+          buffer[2 * k] = re * re + im * im;
+          buffer[2 * k + 1] = 0.0f;
+        }
+      }
+    }
+
+    float scale = 1.0f / fftLength;
+
+    // compact the real parts, index tau only reads 2 * tau >= tau
+    for (int tau = 0; tau <= maxLag; tau++) {
+      buffer[tau] = buffer[2 * tau] * scale;
+    }
+  #else
+    float* input = _fftBuffer;
+    float* output = _outputBuffer;
+
+    memcpy(input, _windowBuffer, _length * sizeof(float));
+    memset(input + _length, 0, _length * sizeof(float));
+
+    arm_rfft_fast_f32(&_S, input, output, 0);
+
+    // packed as DC, Nyquist, then Re, Im of bins 1 .. fftLength / 2 - 1
+    output[0] = output[0] * output[0];
+    output[1] = output[1] * output[1];
+    for (int k = 2; k < fftLength; k += 2) {
+      output[k] = output[k] * output[k] + output[k + 1] * output[k + 1];
+      output[k + 1] = 0.0f;
+    }
+
+    // the inverse transform includes the 1 / fftLength scaling
+    arm_rfft_fast_f32(&_S, output, input, 1);
+  #endif
+}
+
+/*
+ * 1. Autocorrelation of the window, see autocorrelation()
+ * 2. Difference d(tau) = head(tau) + tail(tau) - 2 * r(tau), with the energies of the first and
+ *    last _length - tau samples updated one sample per lag
+ * 3. Cumulative mean normalized difference d'(tau) = d(tau) * tau / sum(d(1 .. tau)), in place
+ * 4. First lag of the frequency range under the threshold, followed down to its minimum and
+ *    refined with a parabola, confidence is 1 - d'
+ */
+void PitchAnalyzer::estimate()
+{
+  int maxLag = _length / 2;
+  int minTau = 2;
+  int maxTau = maxLag;
+
+  if (_highFrequency > 0.0f && _sampleRate / _highFrequency > minTau) {
+    minTau = (int)(_sampleRate / _highFrequency);
+  }
+  if (_lowFrequency > 0.0f && _sampleRate / _lowFrequency + 1 < maxTau) {
+    maxTau = (int)(_sampleRate / _lowFrequency) + 1;
+  }
+
+  autocorrelation();
+
+  float* d = _fftBuffer;
+  float energy = d[0];
+  float head = energy;
+  float tail = energy;
+  float sum = 0.0f;
+
+  d[0] = 1.0f;
+
+  for (int tau = 1; tau <= maxTau; tau++) {
+    float x0 = _windowBuffer[tau - 1];
+    float x1 = _windowBuffer[_length - tau];
+
+    head -= x1 * x1;
+    tail -= x0 * x0;
+
+    float difference = head + tail - 2.0f * d[tau];
+
+    if (difference < 0.0f) {
+      // rounding of a strongly periodic window
+      difference = 0.0f;
+    }
+
+    sum += difference;
+    d[tau] = (sum > 0.0f) ? difference * tau / sum : 1.0f;
+  }
+
+  int best = -1;
+  float minimum = 1.0f;
+
+  for (int tau = minTau; tau <= maxTau; tau++) {
+    if (d[tau] < _threshold) {
+      while (tau < maxTau && d[tau + 1] < d[tau]) {
+        tau++;
+      }
+
+      best = tau;
+      break;
+    }
+
+    if (d[tau] < minimum) {
+      minimum = d[tau];
+    }
+  }
+
+  if (best < 0 || energy <= 0.0f) {
+    _frequency = 0.0f;
+    _confidence = (energy > 0.0f) ? 1.0f - minimum : 0.0f;
+
+    return;
+  }
+
+  float period = best;
+
+  if (best > 1 && best < maxTau) {
+    float a = d[best - 1];
+    float b = d[best];
+    float c = d[best + 1];
+    float curvature = a - 2.0f * b + c;
+
+    if (curvature > 0.0f) {
+      period += 0.5f * (a - c) / curvature;
+    }
+  }
+
+  _frequency = _sampleRate / period;
+  _confidence = 1.0f - d[best];
+
+  if (_confidence < 0.0f) {
+    _confidence = 0.0f;
+  }
+}
+
+void PitchAnalyzer::freeBuffers()
+{
+  if (_sampleBuffer) {
+    free(_sampleBuffer);
+    _sampleBuffer = NULL;
+  }
+
+  if (_windowBuffer) {
+    free(_windowBuffer);
+    _windowBuffer = NULL;
+  }
+
+  if (_fftBuffer) {
+    free(_fftBuffer);
+    _fftBuffer = NULL;
+  }
+
+#ifdef ESP_PLATFORM
+  if (_twiddleBuffer) {
+    free(_twiddleBuffer);
+    _twiddleBuffer = NULL;
+  }
+
+  if (_data_buffer) {
+    free(_data_buffer);
+    _data_buffer = NULL;
+  }
+#else
+  if (_outputBuffer) {
+    free(_outputBuffer);
+    _outputBuffer = NULL;
+  }
+#endif
+
+  _memoryUsage = 0;
+}
@@ -0,0 +1,109 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef _PITCH_ANALYZER_H_INCLUDED
+#define _PITCH_ANALYZER_H_INCLUDED
+
+#include <Arduino.h>
+
+#ifdef ESP_PLATFORM
+  #include "esp_dsp.h"
+#else
+  #define ARM_MATH_CM0PLUS
+  #include <arm_math.h>
+#endif
+
+#include "AudioAnalyzer.h"
+
+/*
+ * Fundamental frequency with the YIN method over the newest length samples,
+ * once per hop. The difference function
+ *   d(tau) = sum(x[j]^2) + sum(x[j + tau]^2) - 2 * r(tau)
+ * gets its autocorrelation r from the power spectrum of the zero padded
+ * window, two FFTs of 2 * length points instead of length^2 / 2 products.
+ * Lags go up to length / 2, so the lowest frequency is 2 * sampleRate / length.
+ *
+ * ESP32 uses the esp-dsp radix-2 FFT, SAMD the CMSIS arm_rfft_fast_f32.
+ * The SAMD21 has no FPU, but the q15 transform keeps too few bits of the
+ * power spectrum for the normalized difference and q31 needs 64-bit products
+ * the Cortex-M0+ emulates as well, so the float transforms stay. They are too
+ * slow for the I2S interrupt, which only snapshots the window; available()
+ * estimates it, and while a window waits the following hops are skipped.
+ */
+class PitchAnalyzer : public AudioAnalyzer
+{
+public:
+  PitchAnalyzer(int length);
+  virtual ~PitchAnalyzer();
+
+  // frames between two estimates, length by default
+  void setHopSize(int hopSize);
+  // lowest and highest frequency searched for
+  void setFrequencyRange(float low, float high);
+  // YIN absolute threshold on the normalized difference, 0.15 by default
+  void setThreshold(float threshold);
+
+  int available(); // number of estimates since the last read, only the newest is kept; SAMD estimates here
+  // frequency in Hz, 0 when no period was found, and confidence between 0 and 1
+  int read(float* frequency, float* confidence);
+
+  size_t memoryUsage(); // bytes held by the analyzer buffers after configure
+
+protected:
+  virtual int configure(AudioIn* input);
+  virtual void update(const void* buffer, size_t size);
+
+private:
+  void freeBuffers();
+  void writeHistory(const uint8_t* buffer, int frames);
+  void snapshot();
+  void autocorrelation();
+  void estimate();
+
+private:
+  int _length;
+  long _sampleRate;
+  int _bitsPerSample;
+  int _channels;
+  int _hopSize;
+  int _hopFrames; // frames written since the last estimate
+  float _lowFrequency;
+  float _highFrequency;
+  float _threshold;
+
+  int _available;
+  float _frequency;
+  float _confidence;
+
+  float* _sampleBuffer; // circular history of the last _length mono samples
+  int _sampleIndex; // write position, also the oldest sample
+  float* _windowBuffer; // the history of the next estimate, oldest sample first
+  float* _fftBuffer;
+  size_t _memoryUsage;
+
+  #ifdef ESP_PLATFORM
+    float* _twiddleBuffer;
+    uint8_t* _data_buffer;
+  #else
+    float* _outputBuffer;
+    arm_rfft_fast_instance_f32 _S;
+    volatile int _pending; // _windowBuffer holds a hop available() has not estimated yet
+  #endif
+};
+
+#endif
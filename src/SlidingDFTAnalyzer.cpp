@@ -0,0 +1,342 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include <limits.h>
+
+#include "AudioIn.h"
+
+#include "SlidingDFTAnalyzer.h"
+
+#define SLIDING_DFT_CHUNK (int)(sizeof(_samples) / sizeof(_samples[0]))
+
+// the bins are only read when the analyzer is configured by input()
+SlidingDFTAnalyzer::SlidingDFTAnalyzer(int length, const int bins[], int count) :
+  _length(length),
+  _bins(bins),
+  _count(count),
+  _bitsPerSample(-1),
+  _channels(-1),
+  _available(0),
+  _historyIndex(0),
+  _anchorBin(0),
+  _binBuffer(NULL),
+  _history(NULL)
+{
+}
+
+SlidingDFTAnalyzer::~SlidingDFTAnalyzer()
+{
+  detach();
+  freeBuffers();
+}
+
+int SlidingDFTAnalyzer::available()
+{
+  #ifdef ESP_PLATFORM
+    if (_attachedInput == NULL) {
+      return 0;
+    }
+
+    _attachedInput->read(_data_buffer, sizeof(_data_buffer));
+  #endif
+
+  return _available;
+}
+
+int SlidingDFTAnalyzer::read(float magnitude[], int size)
+{
+  if (_binBuffer == NULL) {
+    return 0;
+  }
+
+  if (size > _count) {
+    size = _count;
+  }
+
+  for (int i = 0; i < size; i++) {
+    Bin* bin = &_binBuffer[i];
+    float real = bin->real;
+    float imag = bin->imag;
+    // a sine of amplitude A reads A * length / 2, DC and Nyquist A * length
+    float scale = (bin->index == 0 || 2 * bin->index == _length) ? 1.0f / _length : 2.0f / _length;
+
+    #ifndef ESP_PLATFORM
+      if (_bitsPerSample == 32) {
+        // 32-bit samples are kept as their upper 16 bits
+        scale *= 65536.0f;
+      }
+    #endif
+
+    magnitude[i] = sqrtf(real * real + imag * imag) * scale;
+  }
+
+  _available = 0;
+
+  return size;
+}
+
+int SlidingDFTAnalyzer::configure(AudioIn* input)
+{
+  int bitsPerSample = input->bitsPerSample();
+  int channels = input->channels();
+
+  if (bitsPerSample != 16 && bitsPerSample != 32) {
+    return 0;
+  }
+
+  if (channels != 1 && channels != 2) {
+    return 0;
+  }
+
+  // the fixed point bins hold up to length * 2^16, keep them below 2^30
+  if (_length < 2 || _length > 8192 || _count <= 0) {
+    return 0;
+  }
+
+  for (int i = 0; i < _count; i++) {
+    if (_bins[i] < 0 || 2 * _bins[i] > _length) {
+      return 0;
+    }
+  }
+
+  freeBuffers();
+
+  _binBuffer = (Bin*)calloc(_count, sizeof(Bin));
+  #ifdef ESP_PLATFORM
+    _history = (float*)calloc(_length, sizeof(float));
+  #else
+    _history = (int16_t*)calloc(_length, sizeof(int16_t));
+  #endif
+
+  if (_binBuffer == NULL || _history == NULL) {
+    freeBuffers();
+
+    return 0;
+  }
+
+  for (int i = 0; i < _count; i++) {
+    float w = 2.0f * PI * _bins[i] / _length;
+
+    _binBuffer[i].index = _bins[i];
+    #ifdef ESP_PLATFORM
+      _binBuffer[i].twiddleReal = cosf(w);
+      _binBuffer[i].twiddleImag = sinf(w);
+    #else
+      _binBuffer[i].twiddleReal = (int32_t)lroundf(cosf(w) * 1073741824.0f);
+      _binBuffer[i].twiddleImag = (int32_t)lroundf(sinf(w) * 1073741824.0f);
+    #endif
+  }
+
+  _bitsPerSample = bitsPerSample;
+  _channels = channels;
+  _available = 0;
+  _historyIndex = 0;
+  _anchorBin = 0;
+
+  return 1;
+}
+
+/*
+ * 1. Split the block where the history wraps around and in chunks of SLIDING_DFT_CHUNK frames
+ * 2. Average the chunk to mono, store it in the history and keep x[n] - x[n-length]
+ * 3. Slide every bin over the chunk: X = (X + x[n] - x[n-length]) * e^(j*w)
+ * 4. When the history wraps around recompute the next bin from it
+ */
+void SlidingDFTAnalyzer::update(const void* buffer, size_t size)
+{
+  int frameSize = (_bitsPerSample / 8) * _channels;
+  int frames = size / frameSize;
+  const uint8_t* src = (const uint8_t*)buffer;
+
+  if (_available < INT_MAX - frames) {
+    _available += frames;
+  } else {
+    _available = INT_MAX;
+  }
+
+  while (frames > 0) {
+    int chunk = _length - _historyIndex;
+
+    if (chunk > frames) {
+      chunk = frames;
+    }
+
+    chunk = downmix(src, chunk);
+
+    for (int i = 0; i < chunk; i++) {
+      _delta[i] = _samples[i] - _history[_historyIndex + i];
+      _history[_historyIndex + i] = _samples[i];
+    }
+
+    for (int k = 0; k < _count; k++) {
+      Bin* bin = &_binBuffer[k];
+
+      #ifdef ESP_PLATFORM
+        float c = bin->twiddleReal;
+        float s = bin->twiddleImag;
+        float real = bin->real;
+        float imag = bin->imag;
+
+        for (int i = 0; i < chunk; i++) {
+          float a = real + _delta[i];
+
+          real = a * c - imag * s;
+          imag = a * s + imag * c;
+        }
+      #else
+        int32_t c = bin->twiddleReal;
+        int32_t s = bin->twiddleImag;
+        int32_t real = bin->real;
+        int32_t imag = bin->imag;
+
+        for (int i = 0; i < chunk; i++) {
+          int32_t a = real + _delta[i];
+
+          real = (int32_t)(((int64_t)a * c - (int64_t)imag * s + (1 << 29)) >> 30);
+          imag = (int32_t)(((int64_t)a * s + (int64_t)imag * c + (1 << 29)) >> 30);
+        }
+      #endif
+
+      bin->real = real;
+      bin->imag = imag;
+    }
+
+    src += chunk * frameSize;
+    frames -= chunk;
+    _historyIndex += chunk;
+
+    if (_historyIndex == _length) {
+      _historyIndex = 0;
+
+      anchor(&_binBuffer[_anchorBin]);
+      _anchorBin = (_anchorBin + 1) % _count;
+    }
+  }
+}
+
+// average up to SLIDING_DFT_CHUNK frames to mono into _samples, returns the frames taken
+int SlidingDFTAnalyzer::downmix(const uint8_t* buffer, int frames)
+{
+  if (frames > SLIDING_DFT_CHUNK) {
+    frames = SLIDING_DFT_CHUNK;
+  }
+
+  if (_bitsPerSample == 16) {
+    const int16_t* src = (const int16_t*)buffer;
+
+    for (int i = 0; i < frames; i++) {
+      int32_t sample = *src++;
+
+      if (_channels == 2) {
+        sample = (sample + *src++) >> 1;
+      }
+
+      _samples[i] = sample;
+    }
+  } else {
+    const int32_t* src = (const int32_t*)buffer;
+
+    for (int i = 0; i < frames; i++) {
+      #ifdef ESP_PLATFORM
+        float sample = *src++;
+
+        if (_channels == 2) {
+          sample = 0.5f * (sample + *src++);
+        }
+      #else
+        int32_t sample = *src++ >> 16;
+
+        if (_channels == 2) {
+          sample = (sample + (*src++ >> 16)) >> 1;
+        }
+      #endif
+
+      _samples[i] = sample;
+    }
+  }
+
+  return frames;
+}
+
+// direct DFT of the history, oldest sample first, which drops the rounding
+// errors the recursion gathered: X = sum(x[m] * e^(-j*w*m))
+void SlidingDFTAnalyzer::anchor(Bin* bin)
+{
+  int oldest = _historyIndex;
+
+  #ifdef ESP_PLATFORM
+    float real = 0.0f;
+    float imag = 0.0f;
+    float phaseReal = 1.0f;
+    float phaseImag = 0.0f;
+
+    for (int m = 0; m < _length; m++) {
+      if ((m & 63) == 0) {
+        // restart the phase rotation from an exact angle now and then
+        float w = 2.0f * PI * (int)(((long long)bin->index * m) % _length) / _length;
+
+        phaseReal = cosf(w);
+        phaseImag = -sinf(w);
+      }
+
+      float x = _history[(oldest + m) % _length];
+      float nextReal = phaseReal * bin->twiddleReal + phaseImag * bin->twiddleImag;
+
+      real += x * phaseReal;
+      imag += x * phaseImag;
+
+      phaseImag = phaseImag * bin->twiddleReal - phaseReal * bin->twiddleImag;
+      phaseReal = nextReal;
+    }
+  #else
+    int64_t real = 0;
+    int64_t imag = 0;
+    int32_t phaseReal = 1073741824;
+    int32_t phaseImag = 0;
+
+    for (int m = 0; m < _length; m++) {
+      int32_t x = _history[(oldest + m) % _length];
+      int32_t nextReal = (int32_t)(((int64_t)phaseReal * bin->twiddleReal + (int64_t)phaseImag * bin->twiddleImag + (1 << 29)) >> 30);
+
+      real += (int64_t)x * phaseReal;
+      imag += (int64_t)x * phaseImag;
+
+      phaseImag = (int32_t)(((int64_t)phaseImag * bin->twiddleReal - (int64_t)phaseReal * bin->twiddleImag + (1 << 29)) >> 30);
+      phaseReal = nextReal;
+    }
+
+    real = (real + (1 << 29)) >> 30;
+    imag = (imag + (1 << 29)) >> 30;
+  #endif
+
+  bin->real = real;
+  bin->imag = imag;
+}
+
+void SlidingDFTAnalyzer::freeBuffers()
+{
+  if (_binBuffer) {
+    free(_binBuffer);
+    _binBuffer = NULL;
+  }
+
+  if (_history) {
+    free(_history);
+    _history = NULL;
+  }
+}
@@ -0,0 +1,98 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef _SLIDING_DFT_ANALYZER_H_INCLUDED
+#define _SLIDING_DFT_ANALYZER_H_INCLUDED
+
+#include <Arduino.h>
+
+#include "AudioAnalyzer.h"
+
+/*
+ * A few bins of a length point DFT, updated on every sample with the sliding
+ * DFT recursion X[n] = (X[n-1] + x[n] - x[n-length]) * e^(j*2*pi*bin/length).
+ * Each bin costs one complex multiply per sample, whatever the length, and the
+ * result always covers the newest length samples.
+ *
+ * Rounding errors of the recursion never decay, so every time the sample
+ * history wraps around one bin (in turn) is recomputed directly from it.
+ *
+ * On ESP32 the bins are computed in float, on SAMD in fixed point.
+ */
+class SlidingDFTAnalyzer : public AudioAnalyzer
+{
+public:
+  // bins are DFT bin indexes between 0 and length / 2
+  SlidingDFTAnalyzer(int length, const int bins[], int count);
+  virtual ~SlidingDFTAnalyzer();
+
+  // number of samples taken in since the last read
+  int available();
+  // magnitude of each bin in sample units: a full scale 16-bit sine
+  // at the bin frequency reads about 32767
+  int read(float magnitude[], int size);
+
+protected:
+  virtual int configure(AudioIn* input);
+  virtual void update(const void* buffer, size_t size);
+
+private:
+  struct Bin {
+    int index;
+    #ifdef ESP_PLATFORM
+      float twiddleReal; // e^(j*2*pi*index/length)
+      float twiddleImag;
+      float real;
+      float imag;
+    #else
+      int32_t twiddleReal; // Q30
+      int32_t twiddleImag;
+      int32_t real;
+      int32_t imag;
+    #endif
+  };
+
+  int downmix(const uint8_t* buffer, int frames);
+  void anchor(Bin* bin);
+  void freeBuffers();
+
+private:
+  int _length;
+  const int* _bins;
+  int _count;
+  int _bitsPerSample;
+  int _channels;
+  int _available;
+  int _historyIndex; // next history slot, the oldest sample
+  int _anchorBin;    // next bin recomputed from the history
+
+  Bin* _binBuffer;
+
+  #ifdef ESP_PLATFORM
+    float* _history;
+    float _samples[64]; // new samples of the chunk
+    float _delta[64];   // x[n] - x[n-length] of the chunk
+    uint8_t _data_buffer[256];
+  #else
+    int16_t* _history;
+    int16_t _samples[64];
+    int32_t _delta[64];
+  #endif
+};
+
+#endif
@@ -0,0 +1,175 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef _STATIC_FFT_ANALYZER_H_INCLUDED
+#define _STATIC_FFT_ANALYZER_H_INCLUDED
+
+#include "FFTAnalyzer.h"
+
+/*
+ * FFTAnalyzer with its length and sample type fixed at compile time:
+ *
+ *   StaticFFTAnalyzer<1024, int16_t> fftAnalyzer;
+ *
+ * All buffers are members of the object, so a global analyzer lives in .bss
+ * and configure() does not touch the heap (the window slot is reserved too).
+ * On ESP32 the twiddle and bit reversal tables are computed by the compiler
+ * into .rodata (flash) and configure() does no table setup. On SAMD the
+ * CMSIS arm_rfft tables are already constant, so only the buffers are static.
+ *
+ * T is int16_t for 16-bit input or int32_t for 32-bit input.
+ */
+
+#ifdef ESP_PLATFORM
+
+// compile time index sequence, built in log2(N) template steps to stay far
+// below the compiler's template depth limit for large FFTs
+template<int... I> struct StaticFFTIndexList {};
+
+template<typename A, typename B> struct StaticFFTIndexConcat;
+
+template<int... I, int... J> struct StaticFFTIndexConcat<StaticFFTIndexList<I...>, StaticFFTIndexList<J...> > {
+  typedef StaticFFTIndexList<I..., (int)(sizeof...(I) + J)...> type;
+};
+
+template<int N> struct StaticFFTIndices {
+  typedef typename StaticFFTIndexConcat<typename StaticFFTIndices<N / 2>::type, typename StaticFFTIndices<N - N / 2>::type>::type type;
+};
+
+template<> struct StaticFFTIndices<0> {
+  typedef StaticFFTIndexList<> type;
+};
+
+template<> struct StaticFFTIndices<1> {
+  typedef StaticFFTIndexList<0> type;
+};
+
+// constexpr versions of the table generation done by FFTAnalyzer::configure()
+struct StaticFFTMath
+{
+  static constexpr double pi() {
+    return 3.14159265358979323846;
+  }
+
+  // Taylor series, the angles used below stay within [0, pi]
+  static constexpr double sinTerms(double x2, double term, int n) {
+    return n > 24 ? term : term + sinTerms(x2, -term * x2 / ((2 * n) * (2 * n + 1)), n + 1);
+  }
+
+  static constexpr double sin(double x) {
+    return sinTerms(x * x, x, 1);
+  }
+
+  static constexpr double cosTerms(double x2, double term, int n) {
+    return n > 24 ? term : term + cosTerms(x2, -term * x2 / ((2 * n - 1) * (2 * n)), n + 1);
+  }
+
+  static constexpr double cos(double x) {
+    return cosTerms(x * x, 1.0, 1);
+  }
+
+  static constexpr int log2(int n) {
+    return n <= 1 ? 0 : 1 + log2(n / 2);
+  }
+
+  static constexpr int bitReverse(int x, int bits) {
+    return bits == 0 ? 0 : ((x & 1) << (bits - 1)) | bitReverse(x >> 1, bits - 1);
+  }
+
+  // dsps_gen_w_r2_*(w, M) followed by dsps_bit_rev_*(w, M / 2)
+  static constexpr double fftTwiddle(int M, int point, int imag) {
+    return imag ? sin(2.0 * pi() * bitReverse(point, log2(M / 2)) / M)
+                : cos(2.0 * pi() * bitReverse(point, log2(M / 2)) / M);
+  }
+
+  // fft_split_twiddles_*(w, N)
+  static constexpr double splitTwiddle(int N, int k, int imag) {
+    return imag ? -sin(2.0 * pi() * k / N) : cos(2.0 * pi() * k / N);
+  }
+
+  // entry i of the N + 2 entry twiddle table of a length N real input FFT
+  static constexpr double twiddle(int N, int i) {
+    return i < N / 2 ? fftTwiddle(N / 2, i / 2, i & 1) : splitTwiddle(N, (i - N / 2) / 2, (i - N / 2) & 1);
+  }
+
+  static constexpr int16_t twiddleInt16(int N, int i) {
+    // esp-dsp truncates its sc16 twiddles, fft_split_twiddles_int16 rounds
+    return i < N / 2 ? (int16_t)(32767.0 * twiddle(N, i))
+                     : (int16_t)(twiddle(N, i) >= 0.0 ? (int)(32767.0 * twiddle(N, i) + 0.5) : -(int)(-32767.0 * twiddle(N, i) + 0.5));
+  }
+};
+
+template<int N, typename T, typename I = typename StaticFFTIndices<N + 2>::type> struct StaticFFTTwiddles;
+
+template<int N, int... I> struct StaticFFTTwiddles<N, int16_t, StaticFFTIndexList<I...> > {
+  static const int16_t table[N + 2];
+};
+
+template<int N, int... I> const int16_t StaticFFTTwiddles<N, int16_t, StaticFFTIndexList<I...> >::table[N + 2] = {
+  StaticFFTMath::twiddleInt16(N, I)...
+};
+
+// 32-bit input is transformed in floating point
+template<int N, int... I> struct StaticFFTTwiddles<N, int32_t, StaticFFTIndexList<I...> > {
+  static const float table[N + 2];
+};
+
+template<int N, int... I> const float StaticFFTTwiddles<N, int32_t, StaticFFTIndexList<I...> >::table[N + 2] = {
+  (float)StaticFFTMath::twiddle(N, I)...
+};
+
+// bit reversal permutation of the M point half size FFT
+template<int M, typename I = typename StaticFFTIndices<M>::type> struct StaticFFTBitReverse;
+
+template<int M, int... I> struct StaticFFTBitReverse<M, StaticFFTIndexList<I...> > {
+  static const uint16_t table[M];
+};
+
+template<int M, int... I> const uint16_t StaticFFTBitReverse<M, StaticFFTIndexList<I...> >::table[M] = {
+  (uint16_t)StaticFFTMath::bitReverse(I, StaticFFTMath::log2(M))...
+};
+
+#endif // #ifdef ESP_PLATFORM
+
+template<int N, typename T = int16_t>
+class StaticFFTAnalyzer : public FFTAnalyzer
+{
+  static_assert(N >= 8 && (N & (N - 1)) == 0, "StaticFFTAnalyzer length must be a power of two of at least 8");
+  static_assert(sizeof(T) == 2 || sizeof(T) == 4, "StaticFFTAnalyzer samples must be int16_t or int32_t");
+
+public:
+  StaticFFTAnalyzer() :
+  #ifdef ESP_PLATFORM
+    FFTAnalyzer(N, sizeof(T) * 8, (uint8_t*)_buffers, StaticFFTTwiddles<N, T>::table, StaticFFTBitReverse<N / 2>::table)
+  #else
+    FFTAnalyzer(N, sizeof(T) * 8, (uint8_t*)_buffers, NULL, NULL)
+  #endif
+  {
+  }
+
+  virtual ~StaticFFTAnalyzer()
+  {
+    // _buffers go away before ~FFTAnalyzer() runs
+    detach();
+  }
+
+private:
+  uint32_t _buffers[storageSize(N, sizeof(T)) / sizeof(uint32_t)];
+};
+
+#endif // #ifndef _STATIC_FFT_ANALYZER_H_INCLUDED
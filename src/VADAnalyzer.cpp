@@ -0,0 +1,246 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#include "AudioIn.h"
+
+#include "VADAnalyzer.h"
+
+#define FLOOR_SUB_WINDOWS (int)(sizeof(_minima) / sizeof(_minima[0]))
+#define SUB_WINDOW_FRAMES 25 // 250 ms
+#define ONSET_FRAMES 2
+#define UNVOICED_CROSSINGS 4800L // crossings per second of fricatives, voiced speech stays far below
+#define MIN_FLOOR 1.0f // mean square of a 1 LSB 16-bit signal, digital silence still needs a threshold
+
+VADAnalyzer::VADAnalyzer() :
+  _speechRatio(10.0f), // 10 dB
+  _unvoicedRatio(3.16227766f),
+  _hangover(300),
+  _bitsPerSample(-1),
+  _channels(-1),
+  _frameSize(0),
+  _frameSamples(0),
+  _unvoicedCrossings(0),
+  _energy(0),
+  _crossings(0),
+  _previous(0),
+  _minimumIndex(0),
+  _minimumCount(0),
+  _subWindowFrames(0),
+  _floor(MIN_FLOOR),
+  _speechFrames(0),
+  _hangoverFrames(0),
+  _speech(false),
+  _available(0)
+{
+  memset(_minima, 0x00, sizeof(_minima));
+}
+
+VADAnalyzer::~VADAnalyzer()
+{
+  detach();
+}
+
+void VADAnalyzer::setThreshold(float decibels)
+{
+  float ratio = powf(10.0f, decibels / 10.0f);
+
+  #ifndef ESP_PLATFORM
+    // the ratios are used from the I2S interrupt
+    noInterrupts();
+  #endif
+  _speechRatio = ratio;
+  _unvoicedRatio = sqrtf(ratio);
+  #ifndef ESP_PLATFORM
+    interrupts();
+  #endif
+}
+
+void VADAnalyzer::setHangover(int milliseconds)
+{
+  _hangover = milliseconds;
+}
+
+bool VADAnalyzer::speech()
+{
+  return _speech;
+}
+
+int VADAnalyzer::available()
+{
+  #ifdef ESP_PLATFORM
+    if (_attachedInput == NULL) {
+      return 0;
+    }
+
+    _attachedInput->read(_data_buffer, sizeof(_data_buffer));
+  #endif
+
+  return _available;
+}
+
+int VADAnalyzer::read()
+{
+  #ifndef ESP_PLATFORM
+    // finishFrame() counts the state changes from the I2S interrupt
+    noInterrupts();
+  #endif
+  bool speech = _speech;
+  _available = 0;
+  #ifndef ESP_PLATFORM
+    interrupts();
+  #endif
+
+  return speech ? 1 : 0;
+}
+
+int VADAnalyzer::configure(AudioIn* input)
+{
+  int bitsPerSample = input->bitsPerSample();
+  int channels = input->channels();
+  long sampleRate = input->sampleRate();
+
+  if (bitsPerSample != 16 && bitsPerSample != 32) {
+    return 0;
+  }
+
+  if (channels != 1 && channels != 2) {
+    return 0;
+  }
+
+  if (sampleRate < 1000) {
+    return 0;
+  }
+
+  _bitsPerSample = bitsPerSample;
+  _channels = channels;
+  _frameSize = sampleRate / 100;
+  _frameSamples = 0;
+  _unvoicedCrossings = (int)(UNVOICED_CROSSINGS * _frameSize / sampleRate);
+  _energy = 0;
+  _crossings = 0;
+  _previous = 0;
+  _minimumIndex = 0;
+  _minimumCount = 0;
+  _subWindowFrames = 0;
+  _floor = MIN_FLOOR;
+  _speechFrames = 0;
+  _hangoverFrames = 0;
+  _speech = false;
+  _available = 0;
+
+  return 1;
+}
+
+// 32-bit samples are reduced to their top 16 bits, the decision only compares levels
+void VADAnalyzer::update(const void* buffer, size_t size)
+{
+  if (_bitsPerSample == -1) {
+    return;
+  }
+
+  int frames = size / (_bitsPerSample / 8) / _channels;
+  int16_t previous = _previous;
+
+  for (int i = 0; i < frames; i++) {
+    int32_t x;
+
+    if (_bitsPerSample == 16) {
+      const int16_t* src = (const int16_t*)buffer + i * _channels;
+
+      x = (_channels == 2) ? ((int32_t)src[0] + src[1]) >> 1 : src[0];
+    } else {
+      const int32_t* src = (const int32_t*)buffer + i * _channels;
+
+      x = (_channels == 2) ? ((src[0] >> 16) + (src[1] >> 16)) >> 1 : src[0] >> 16;
+    }
+
+    _energy += (uint32_t)(x * x);
+    // the sign bit differs from the previous sample's
+    _crossings += ((x ^ previous) < 0);
+    previous = (int16_t)x;
+
+    if (++_frameSamples == _frameSize) {
+      finishFrame();
+    }
+  }
+
+  _previous = previous;
+}
+
+/*
+ * 1. Classify the frame against the noise floor
+ * 2. Speech starts after ONSET_FRAMES speech frames and ends once the hangover has run out
+ * 3. Track the lowest frame energy of each sub-window, the floor is the lowest of them
+ */
+void VADAnalyzer::finishFrame()
+{
+  float energy = (float)_energy / _frameSize;
+  float ratio = energy / _floor;
+  bool speechFrame = false;
+
+  if (_minimumCount > 0) {
+    speechFrame = (ratio > _speechRatio) || (ratio > _unvoicedRatio && _crossings > _unvoicedCrossings);
+  }
+
+  if (speechFrame) {
+    _speechFrames++;
+
+    if (_speechFrames >= ONSET_FRAMES) {
+      _hangoverFrames = _hangover / 10;
+
+      if (!_speech) {
+        _speech = true;
+        _available++;
+      }
+    }
+  } else {
+    _speechFrames = 0;
+
+    if (_speech && --_hangoverFrames <= 0) {
+      _speech = false;
+      _available++;
+    }
+  }
+
+  if (_subWindowFrames == 0 || energy < _minima[_minimumIndex]) {
+    _minima[_minimumIndex] = energy;
+  }
+
+  if (++_subWindowFrames == SUB_WINDOW_FRAMES) {
+    _subWindowFrames = 0;
+
+    if (_minimumCount < FLOOR_SUB_WINDOWS) {
+      _minimumCount++;
+    }
+
+    float floor = _minima[0];
+
+    for (int i = 1; i < _minimumCount; i++) {
+      if (_minima[i] < floor) {
+        floor = _minima[i];
+      }
+    }
+
+    _floor = (floor > MIN_FLOOR) ? floor : MIN_FLOOR;
+    _minimumIndex = (_minimumIndex + 1) % FLOOR_SUB_WINDOWS;
+  }
+
+  _frameSamples = 0;
+  _energy = 0;
+  _crossings = 0;
+}
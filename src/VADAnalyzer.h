@@ -0,0 +1,94 @@
+/*
+  Copyright (c) 2016 Arduino LLC. All right reserved.
+
+  This library is free software; you can redistribute it and/or
+  modify it under the terms of the GNU Lesser General Public
+  License as published by the Free Software Foundation; either
+  version 2.1 of the License, or (at your option) any later version.
+
+  This library is distributed in the hope that it will be useful,
+  but WITHOUT ANY WARRANTY; without even the implied warranty of
+  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+  Lesser General Public License for more details.
+
+  You should have received a copy of the GNU Lesser General Public
+  License along with this library; if not, write to the Free Software
+  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA
+*/
+
+#ifndef _VAD_ANALYZER_H_INCLUDED
+#define _VAD_ANALYZER_H_INCLUDED
+
+#include <Arduino.h>
+
+#include "AudioAnalyzer.h"
+
+/*
+ * Voice activity detection from the short-term energy and the zero crossing
+ * rate of the downmixed input. Each sample costs a square, an add and a sign
+ * test; every 10 ms frame is then classified:
+ *
+ *   speech frame: energy threshold dB over the noise floor, or half of that
+ *                 with a zero crossing rate of unvoiced sounds (s, f, sh)
+ *
+ * The noise floor is the lowest frame energy of the last 2 s, so it follows
+ * the room noise even while someone speaks. Speech starts after 2 speech
+ * frames in a row and ends hangover ms after the last one, so short pauses
+ * and single clicks do not toggle the state.
+ *
+ * speech() is a single flag read, cheap enough to gate every block of other
+ * processing. On ESP32 available() reads the input.
+ */
+class VADAnalyzer : public AudioAnalyzer
+{
+public:
+  VADAnalyzer();
+  virtual ~VADAnalyzer();
+
+  // energy of speech frames in dB over the noise floor, 10 dB by default
+  void setThreshold(float decibels);
+  // speech lasts this long after the last speech frame, 300 ms by default
+  void setHangover(int milliseconds);
+
+  bool speech(); // current state, true while speech is detected
+
+  int available(); // number of state changes since the last read
+  int read(); // 1 for speech and 0 for silence, clears available()
+
+protected:
+  virtual int configure(AudioIn* input);
+  virtual void update(const void* buffer, size_t size);
+
+private:
+  void finishFrame();
+
+private:
+  float _speechRatio; // energy ratios over the floor, from the threshold
+  float _unvoicedRatio;
+  int _hangover;
+  int _bitsPerSample;
+  int _channels;
+  int _frameSize; // samples of a 10 ms frame
+  int _frameSamples;
+  int _unvoicedCrossings; // zero crossings per frame of unvoiced sounds, from the sample rate
+  uint64_t _energy; // sum of squares of the current frame, 16-bit samples
+  int _crossings; // zero crossings of the current frame
+  int16_t _previous; // last sample, for the crossings
+
+  float _minima[8]; // lowest frame energy of each of the last 8 sub-windows of 250 ms
+  int _minimumIndex;
+  int _minimumCount;
+  int _subWindowFrames;
+  float _floor;
+
+  int _speechFrames; // consecutive speech frames
+  int _hangoverFrames; // frames left before speech ends
+  volatile bool _speech;
+  int _available;
+
+  #ifdef ESP_PLATFORM
+    uint8_t _data_buffer[256];
+  #endif
+};
+
+#endif